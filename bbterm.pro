@@ -23,3 +23,6 @@ LIBS += \
 
 include(src/src.pri)
 
+# 'make check' builds tests in tests/ and runs them
+check.commands = $(MKDIR) tests && cd tests && $(QMAKE) $$PWD/tests/tests.pro && $(MAKE) check
+QMAKE_EXTRA_TARGETS += check
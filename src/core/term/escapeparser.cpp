@@ -0,0 +1,383 @@
+#include "escapeparser.h"
+#include "screenbuffer.h"
+
+#include <core/util/bytescan.h>
+#include <core/util/log.h>
+
+using namespace core::term;
+
+namespace {
+
+// all characters >= 0xA0 share the last column
+const int ColumnCount = 0xa1;
+const quint8 NoTransition = EscapeParser::StateCount;
+
+struct Transition
+{
+	quint8 action;
+	quint8 state;
+};
+
+class TransitionTable
+{
+public:
+	TransitionTable();
+
+	const Transition& at(int state, uint c) const
+	{
+		return m_table[state][(c < 0xa0)? c: 0xa0];
+	}
+	int entryAction(int state) const {return m_entryActions[state];}
+	int exitAction(int state) const {return m_exitActions[state];}
+private:
+	void setRange(int state, int from, int to, int action, int next_state = NoTransition)
+	{
+		for(int c=from; c<=to; c++) {
+			m_table[state][c].action = action;
+			m_table[state][c].state = next_state;
+		}
+	}
+	void set(int state, int c, int action, int next_state = NoTransition)
+	{
+		setRange(state, c, c, action, next_state);
+	}
+	// C0 controls except CAN, SUB and ESC, which are handled in 'anywhere' transitions
+	void setC0(int state, int action)
+	{
+		setRange(state, 0x00, 0x17, action);
+		set(state, 0x19, action);
+		setRange(state, 0x1c, 0x1f, action);
+	}
+private:
+	Transition m_table[EscapeParser::StateCount][ColumnCount];
+	quint8 m_entryActions[EscapeParser::StateCount];
+	quint8 m_exitActions[EscapeParser::StateCount];
+};
+
+TransitionTable::TransitionTable()
+{
+	for(int s=0; s<EscapeParser::StateCount; s++) {
+		setRange(s, 0x00, 0xa0, EscapeParser::ActionIgnore);
+		m_entryActions[s] = EscapeParser::ActionNone;
+		m_exitActions[s] = EscapeParser::ActionNone;
+	}
+	m_entryActions[EscapeParser::StateEscape] = EscapeParser::ActionClear;
+	m_entryActions[EscapeParser::StateCsiEntry] = EscapeParser::ActionClear;
+	m_entryActions[EscapeParser::StateDcsEntry] = EscapeParser::ActionClear;
+	m_entryActions[EscapeParser::StateOscString] = EscapeParser::ActionOscStart;
+	m_exitActions[EscapeParser::StateOscString] = EscapeParser::ActionOscEnd;
+	m_entryActions[EscapeParser::StateDcsPassthrough] = EscapeParser::ActionHook;
+	m_exitActions[EscapeParser::StateDcsPassthrough] = EscapeParser::ActionUnhook;
+
+	{
+		int s = EscapeParser::StateGround;
+		setC0(s, EscapeParser::ActionExecute);
+		setRange(s, 0x20, 0x7e, EscapeParser::ActionPrint);
+		set(s, 0xa0, EscapeParser::ActionPrint);
+	}
+	{
+		int s = EscapeParser::StateEscape;
+		setC0(s, EscapeParser::ActionExecute);
+		setRange(s, 0x20, 0x2f, EscapeParser::ActionCollect, EscapeParser::StateEscapeIntermediate);
+		setRange(s, 0x30, 0x7e, EscapeParser::ActionEscDispatch, EscapeParser::StateGround);
+		set(s, 'P', EscapeParser::ActionNone, EscapeParser::StateDcsEntry);
+		set(s, 'X', EscapeParser::ActionNone, EscapeParser::StateSosPmApcString);
+		set(s, '[', EscapeParser::ActionNone, EscapeParser::StateCsiEntry);
+		set(s, ']', EscapeParser::ActionNone, EscapeParser::StateOscString);
+		set(s, '^', EscapeParser::ActionNone, EscapeParser::StateSosPmApcString);
+		set(s, '_', EscapeParser::ActionNone, EscapeParser::StateSosPmApcString);
+	}
+	{
+		int s = EscapeParser::StateEscapeIntermediate;
+		setC0(s, EscapeParser::ActionExecute);
+		setRange(s, 0x20, 0x2f, EscapeParser::ActionCollect);
+		setRange(s, 0x30, 0x7e, EscapeParser::ActionEscDispatch, EscapeParser::StateGround);
+	}
+	{
+		int s = EscapeParser::StateCsiEntry;
+		setC0(s, EscapeParser::ActionExecute);
+		setRange(s, 0x20, 0x2f, EscapeParser::ActionCollect, EscapeParser::StateCsiIntermediate);
+		// ':' separates sub-parameters (ISO 8613-6 colors)
+		setRange(s, 0x30, 0x3b, EscapeParser::ActionParam, EscapeParser::StateCsiParam);
+		setRange(s, 0x3c, 0x3f, EscapeParser::ActionCollect, EscapeParser::StateCsiParam);
+		setRange(s, 0x40, 0x7e, EscapeParser::ActionCsiDispatch, EscapeParser::StateGround);
+	}
+	{
+		int s = EscapeParser::StateCsiParam;
+		setC0(s, EscapeParser::ActionExecute);
+		setRange(s, 0x20, 0x2f, EscapeParser::ActionCollect, EscapeParser::StateCsiIntermediate);
+		setRange(s, 0x30, 0x3b, EscapeParser::ActionParam);
+		setRange(s, 0x3c, 0x3f, EscapeParser::ActionNone, EscapeParser::StateCsiIgnore);
+		setRange(s, 0x40, 0x7e, EscapeParser::ActionCsiDispatch, EscapeParser::StateGround);
+	}
+	{
+		int s = EscapeParser::StateCsiIntermediate;
+		setC0(s, EscapeParser::ActionExecute);
+		setRange(s, 0x20, 0x2f, EscapeParser::ActionCollect);
+		setRange(s, 0x30, 0x3f, EscapeParser::ActionNone, EscapeParser::StateCsiIgnore);
+		setRange(s, 0x40, 0x7e, EscapeParser::ActionCsiDispatch, EscapeParser::StateGround);
+	}
+	{
+		int s = EscapeParser::StateCsiIgnore;
+		setC0(s, EscapeParser::ActionExecute);
+		setRange(s, 0x40, 0x7e, EscapeParser::ActionNone, EscapeParser::StateGround);
+	}
+	{
+		int s = EscapeParser::StateDcsEntry;
+		setRange(s, 0x20, 0x2f, EscapeParser::ActionCollect, EscapeParser::StateDcsIntermediate);
+		setRange(s, 0x30, 0x39, EscapeParser::ActionParam, EscapeParser::StateDcsParam);
+		set(s, 0x3a, EscapeParser::ActionNone, EscapeParser::StateDcsIgnore);
+		set(s, 0x3b, EscapeParser::ActionParam, EscapeParser::StateDcsParam);
+		setRange(s, 0x3c, 0x3f, EscapeParser::ActionCollect, EscapeParser::StateDcsParam);
+		setRange(s, 0x40, 0x7e, EscapeParser::ActionNone, EscapeParser::StateDcsPassthrough);
+	}
+	{
+		int s = EscapeParser::StateDcsParam;
+		setRange(s, 0x20, 0x2f, EscapeParser::ActionCollect, EscapeParser::StateDcsIntermediate);
+		setRange(s, 0x30, 0x39, EscapeParser::ActionParam);
+		set(s, 0x3a, EscapeParser::ActionNone, EscapeParser::StateDcsIgnore);
+		set(s, 0x3b, EscapeParser::ActionParam);
+		setRange(s, 0x3c, 0x3f, EscapeParser::ActionNone, EscapeParser::StateDcsIgnore);
+		setRange(s, 0x40, 0x7e, EscapeParser::ActionNone, EscapeParser::StateDcsPassthrough);
+	}
+	{
+		int s = EscapeParser::StateDcsIntermediate;
+		setRange(s, 0x20, 0x2f, EscapeParser::ActionCollect);
+		setRange(s, 0x30, 0x3f, EscapeParser::ActionNone, EscapeParser::StateDcsIgnore);
+		setRange(s, 0x40, 0x7e, EscapeParser::ActionNone, EscapeParser::StateDcsPassthrough);
+	}
+	{
+		int s = EscapeParser::StateDcsPassthrough;
+		setC0(s, EscapeParser::ActionPut);
+		setRange(s, 0x20, 0x7e, EscapeParser::ActionPut);
+		set(s, 0xa0, EscapeParser::ActionPut);
+	}
+	{
+		int s = EscapeParser::StateOscString;
+		setRange(s, 0x20, 0x7f, EscapeParser::ActionOscPut);
+		set(s, 0xa0, EscapeParser::ActionOscPut);
+		// xterm terminates OSC by BEL too
+		set(s, 0x07, EscapeParser::ActionNone, EscapeParser::StateGround);
+	}
+	// StateDcsIgnore and StateSosPmApcString ignore everything except 'anywhere' transitions
+
+	// transitions from anywhere
+	for(int s=0; s<EscapeParser::StateCount; s++) {
+		set(s, 0x18, EscapeParser::ActionExecute, EscapeParser::StateGround);
+		set(s, 0x1a, EscapeParser::ActionExecute, EscapeParser::StateGround);
+		set(s, 0x1b, EscapeParser::ActionNone, EscapeParser::StateEscape);
+		setRange(s, 0x80, 0x8f, EscapeParser::ActionExecute, EscapeParser::StateGround);
+		set(s, 0x90, EscapeParser::ActionNone, EscapeParser::StateDcsEntry);
+		setRange(s, 0x91, 0x97, EscapeParser::ActionExecute, EscapeParser::StateGround);
+		set(s, 0x98, EscapeParser::ActionNone, EscapeParser::StateSosPmApcString);
+		set(s, 0x99, EscapeParser::ActionExecute, EscapeParser::StateGround);
+		set(s, 0x9a, EscapeParser::ActionExecute, EscapeParser::StateGround);
+		set(s, 0x9b, EscapeParser::ActionNone, EscapeParser::StateCsiEntry);
+		set(s, 0x9c, EscapeParser::ActionNone, EscapeParser::StateGround);
+		set(s, 0x9d, EscapeParser::ActionNone, EscapeParser::StateOscString);
+		setRange(s, 0x9e, 0x9f, EscapeParser::ActionNone, EscapeParser::StateSosPmApcString);
+	}
+}
+
+const TransitionTable s_transitionTable;
+
+}
+
+EscapeParser::EscapeParser(ScreenBuffer *screen_buffer)
+: m_screenBuffer(screen_buffer)
+{
+	m_oscString.reserve(256);
+	reset();
+}
+
+void EscapeParser::reset()
+{
+	m_state = StateGround;
+	m_utf8Decoder.reset();
+	m_params.clear();
+}
+
+void EscapeParser::process(const char *data, int length)
+{
+	int i = 0;
+	while(i < length) {
+		if(m_utf8Decoder.isIdle()) {
+			if(m_state == StateGround) {
+				// most of the input are runs of printable characters, write them at once
+				int n = core::util::printableAsciiLength(data + i, length - i);
+				if(n > 0) {
+					m_screenBuffer->printAscii(data + i, n);
+					i += n;
+					continue;
+				}
+			}
+			uchar c = static_cast<uchar>(data[i]);
+			if(c < 0x80) {
+				// ASCII does not need decoding
+				processCodePoint(c);
+				i++;
+				continue;
+			}
+		}
+		uint code_points[2];
+		int cnt = m_utf8Decoder.decode(static_cast<uchar>(data[i++]), code_points);
+		for(int j=0; j<cnt; j++)
+			processCodePoint(code_points[j]);
+	}
+}
+
+void EscapeParser::processCodePoint(uint c)
+{
+	if(m_state == StateGround && c >= 0x20 && c != 0x7f && (c < 0x80 || c >= 0xa0)) {
+		// most of the input are printable characters, skip table lookup
+		m_screenBuffer->printChar(c);
+	}
+	else {
+		consume(c);
+	}
+}
+
+void EscapeParser::consume(uint c)
+{
+	const Transition &t = s_transitionTable.at(m_state, c);
+	if(t.state == NoTransition) {
+		performAction(t.action, c);
+	}
+	else {
+		performAction(s_transitionTable.exitAction(m_state), c);
+		performAction(t.action, c);
+		m_state = static_cast<State>(t.state);
+		performAction(s_transitionTable.entryAction(m_state), c);
+	}
+}
+
+void EscapeParser::performAction(int action, uint c)
+{
+	switch(action) {
+	case ActionNone:
+	case ActionIgnore:
+		break;
+	case ActionPrint:
+		m_screenBuffer->printChar(c);
+		break;
+	case ActionExecute:
+		m_screenBuffer->executeControl(c);
+		break;
+	case ActionClear:
+		m_params.clear();
+		break;
+	case ActionCollect:
+		collect(c);
+		break;
+	case ActionParam:
+		accumulateParam(c);
+		break;
+	case ActionEscDispatch:
+		m_params.m_finalChar = static_cast<char>(c);
+		if(m_params.m_collectOverflow)
+			LOGWARN() << "too many intermediates in escape sequence, ignored";
+		else
+			m_screenBuffer->escapeDispatch(m_params);
+		break;
+	case ActionCsiDispatch:
+		m_params.m_finalChar = static_cast<char>(c);
+		if(m_params.m_collectOverflow)
+			LOGWARN() << "too many intermediates in control sequence, ignored";
+		else
+			m_screenBuffer->controlSequenceDispatch(m_params);
+		break;
+	case ActionHook:
+	case ActionPut:
+	case ActionUnhook:
+		// DCS sequences are not supported
+		break;
+	case ActionOscStart:
+		m_oscString.resize(0);
+		break;
+	case ActionOscPut:
+		if(m_oscString.length() < MaxOscLength)
+			m_oscString.append(QChar(static_cast<ushort>((c > 0xffff)? core::util::Utf8Decoder::ReplacementCharacter: c)));
+		break;
+	case ActionOscEnd:
+		m_screenBuffer->operatingSystemCommandDispatch(m_oscString);
+		break;
+	}
+}
+
+void EscapeParser::collect(uint c)
+{
+	EscapeParams &p = m_params;
+	if(c >= 0x3c && c <= 0x3f) {
+		if(p.m_privateMarker == 0)
+			p.m_privateMarker = static_cast<char>(c);
+		else
+			p.m_collectOverflow = true;
+	}
+	else if(p.m_intermediateCount < EscapeParams::MaxIntermediates) {
+		p.m_intermediates[p.m_intermediateCount++] = static_cast<char>(c);
+		p.m_intermediates[p.m_intermediateCount] = 0;
+	}
+	else {
+		p.m_collectOverflow = true;
+	}
+}
+
+void EscapeParser::accumulateParam(uint c)
+{
+	EscapeParams &p = m_params;
+	if(p.m_paramOverflow)
+		return;
+	if(p.m_count == 0) {
+		p.m_values[0] = -1;
+		p.m_valueCount = 1;
+		p.m_count = 1;
+		p.m_start[1] = 1;
+	}
+	if(c == ';' || c == ':') {
+		if(p.m_valueCount >= EscapeParams::MaxValues || (c == ';' && p.m_count >= EscapeParams::MaxParams)) {
+			// drop the rest of parameters
+			p.m_paramOverflow = true;
+			return;
+		}
+		p.m_values[p.m_valueCount++] = -1;
+		if(c == ';')
+			p.m_count++;
+		p.m_start[p.m_count] = p.m_valueCount;
+	}
+	else {
+		qint32 &v = p.m_values[p.m_valueCount - 1];
+		if(v < 0)
+			v = 0;
+		// saturate to avoid overflow on malicious input
+		if(v < 0xffff)
+			v = v * 10 + (c - '0');
+	}
+}
+
+QString EscapeParams::toString() const
+{
+	QString ret;
+	if(m_privateMarker)
+		ret += QChar(m_privateMarker);
+	for(int i=0; i<m_count; i++) {
+		if(i > 0)
+			ret += ';';
+		for(int j=0; j<=subParamCount(i); j++) {
+			if(j > 0)
+				ret += ':';
+			int v = subParam(i, j, -1);
+			if(v >= 0)
+				ret += QString::number(v);
+		}
+	}
+	ret += QString::fromLatin1(m_intermediates);
+	if(m_finalChar)
+		ret += QChar(m_finalChar);
+	return ret;
+}
+
+QDebug operator<<(QDebug debug, const EscapeParams &params)
+{
+	debug << params.toString();
+	return debug;
+}
@@ -0,0 +1,152 @@
+#ifndef ESCAPEPARSER_H
+#define ESCAPEPARSER_H
+
+#include <core/util/utf8decoder.h>
+
+#include <QString>
+#include <QDebug>
+
+namespace core {
+namespace term {
+
+class ScreenBuffer;
+
+// Parameters of ESC, CSI and DCS sequences, filled in place by the parser
+// and passed to handlers by reference, dispatch does not need any heap allocation.
+// Parameter values are separated by ';', sub-parameters by ':', for example
+// CSI 38:2::255:0:0 ; 1 m has 2 parameters, the first one with 5 sub-parameters.
+class EscapeParams
+{
+public:
+	static const int MaxParams = 16;
+	static const int MaxValues = 32;
+	static const int MaxIntermediates = 2;
+public:
+	EscapeParams() {clear();}
+
+	void clear()
+	{
+		m_count = 0;
+		m_valueCount = 0;
+		m_start[0] = 0;
+		m_privateMarker = 0;
+		m_finalChar = 0;
+		m_intermediateCount = 0;
+		m_intermediates[0] = 0;
+		m_paramOverflow = false;
+		m_collectOverflow = false;
+	}
+	int count() const {return m_count;}
+	/// returns default_value for omitted parameter
+	int value(int ix, int default_value = 0) const
+	{
+		if(ix < 0 || ix >= m_count)
+			return default_value;
+		int v = m_values[m_start[ix]];
+		return (v < 0)? default_value: v;
+	}
+	int subParamCount(int ix) const
+	{
+		if(ix < 0 || ix >= m_count)
+			return 0;
+		return m_start[ix + 1] - m_start[ix] - 1;
+	}
+	/// sub parameters are indexed from 1, subParam(ix, 0) == value(ix)
+	int subParam(int ix, int sub_ix, int default_value = 0) const
+	{
+		if(sub_ix < 0 || sub_ix > subParamCount(ix))
+			return default_value;
+		int v = m_values[m_start[ix] + sub_ix];
+		return (v < 0)? default_value: v;
+	}
+	char privateMarker() const {return m_privateMarker;}
+	const char* intermediates() const {return m_intermediates;}
+	char finalChar() const {return m_finalChar;}
+
+	QString toString() const;
+private:
+	friend class EscapeParser;
+
+	qint32 m_values[MaxValues];
+	// index of first value of each parameter, m_start[m_count] == m_valueCount
+	quint8 m_start[MaxParams + 1];
+	quint8 m_count;
+	quint8 m_valueCount;
+	char m_privateMarker;
+	char m_finalChar;
+	char m_intermediates[MaxIntermediates + 1];
+	quint8 m_intermediateCount;
+	bool m_paramOverflow;
+	bool m_collectOverflow;
+};
+
+// Table driven DEC/ANSI parser, see http://vt100.net/emu/dec_ansi_parser
+// Every input character is consumed exactly once, parser state survives
+// between calls, so an escape sequence split between two reads is not rescanned.
+// Input is UTF-8, it is decoded on the fly without conversion to QString.
+class EscapeParser
+{
+public:
+	enum State {
+		StateGround = 0,
+		StateEscape,
+		StateEscapeIntermediate,
+		StateCsiEntry,
+		StateCsiParam,
+		StateCsiIntermediate,
+		StateCsiIgnore,
+		StateDcsEntry,
+		StateDcsParam,
+		StateDcsIntermediate,
+		StateDcsPassthrough,
+		StateDcsIgnore,
+		StateOscString,
+		StateSosPmApcString,
+		StateCount
+	};
+
+	enum Action {
+		ActionNone = 0,
+		ActionIgnore,
+		ActionPrint,
+		ActionExecute,
+		ActionClear,
+		ActionCollect,
+		ActionParam,
+		ActionEscDispatch,
+		ActionCsiDispatch,
+		ActionHook,
+		ActionPut,
+		ActionUnhook,
+		ActionOscStart,
+		ActionOscPut,
+		ActionOscEnd
+	};
+
+	static const int MaxOscLength = 4096;
+public:
+	explicit EscapeParser(ScreenBuffer *screen_buffer);
+public:
+	void process(const char *data, int length);
+	void reset();
+	State state() const {return m_state;}
+private:
+	void processCodePoint(uint c);
+	void consume(uint c);
+	void performAction(int action, uint c);
+	void collect(uint c);
+	void accumulateParam(uint c);
+private:
+	ScreenBuffer *m_screenBuffer;
+	State m_state;
+	core::util::Utf8Decoder m_utf8Decoder;
+	EscapeParams m_params;
+	QString m_oscString;
+};
+
+}
+}
+
+QDebug operator<<(QDebug debug, const core::term::EscapeParams &params);
+
+#endif // ESCAPEPARSER_H
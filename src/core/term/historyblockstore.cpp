@@ -0,0 +1,20 @@
+#include "historyblockstore.h"
+
+using namespace core::term;
+
+bool MemoryHistoryBlockStore::append(const QByteArray &block)
+{
+	m_blocks.append(block);
+	// block buffer was grown by appending, do not keep unused capacity
+	m_blocks.last().squeeze();
+	m_byteCount += block.size();
+	return true;
+}
+
+void MemoryHistoryBlockStore::removeFirst()
+{
+	if(m_blocks.isEmpty())
+		return;
+	m_byteCount -= m_blocks.first().size();
+	m_blocks.removeFirst();
+}
@@ -0,0 +1,46 @@
+#ifndef HISTORYBLOCKSTORE_H
+#define HISTORYBLOCKSTORE_H
+
+#include <QByteArray>
+#include <QList>
+
+namespace core {
+namespace term {
+
+// Storage of packed cold history blocks, see ScreenHistory.
+// Blocks are appended at the end and dropped from the beginning only.
+class HistoryBlockStore
+{
+public:
+	virtual ~HistoryBlockStore() {}
+
+	virtual int count() const = 0;
+	/// false if block cannot be stored
+	virtual bool append(const QByteArray &block) = 0;
+	virtual void removeFirst() = 0;
+	/// content of block ix, returned data are valid until next call of block() or append()
+	virtual QByteArray block(int ix) = 0;
+	/// bytes occupied by stored blocks
+	virtual qint64 byteCount() const = 0;
+};
+
+// blocks are kept on the heap
+class MemoryHistoryBlockStore : public HistoryBlockStore
+{
+public:
+	MemoryHistoryBlockStore() : m_byteCount(0) {}
+
+	int count() const Q_DECL_OVERRIDE {return m_blocks.count();}
+	bool append(const QByteArray &block) Q_DECL_OVERRIDE;
+	void removeFirst() Q_DECL_OVERRIDE;
+	QByteArray block(int ix) Q_DECL_OVERRIDE {return m_blocks.at(ix);}
+	qint64 byteCount() const Q_DECL_OVERRIDE {return m_byteCount;}
+private:
+	QList<QByteArray> m_blocks;
+	qint64 m_byteCount;
+};
+
+}
+}
+
+#endif // HISTORYBLOCKSTORE_H
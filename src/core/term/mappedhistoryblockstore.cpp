@@ -0,0 +1,239 @@
+#include "mappedhistoryblockstore.h"
+
+#include <core/util/log.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+using namespace core::term;
+
+namespace {
+
+bool writeFully(int fd, const char *data, qint64 size, qint64 offset)
+{
+	while(size > 0) {
+		ssize_t n = ::pwrite(fd, data, size, offset);
+		if(n < 0) {
+			if(errno == EINTR)
+				continue;
+			return false;
+		}
+		data += n;
+		size -= n;
+		offset += n;
+	}
+	return true;
+}
+
+int openUnlinked(const QByteArray &path)
+{
+	int fd = ::open(path.constData(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if(fd < 0) {
+		LOGERR() << "Unable to open scrollback file" << path << ::strerror(errno);
+		return -1;
+	}
+	::fcntl(fd, F_SETFD, FD_CLOEXEC);
+	if(::unlink(path.constData()) != 0)
+		LOGWARN() << "Unable to unlink scrollback file" << path << ::strerror(errno);
+	return fd;
+}
+
+}
+
+MappedHistoryBlockStore::MappedHistoryBlockStore()
+: m_dataFd(-1), m_indexFd(-1), m_firstBlock(0), m_firstBlockOffset(0), m_blockCount(0), m_dataSize(0)
+, m_indexCapacity(InitialIndexCapacity), m_firstSegment(0), m_slotCount(0), m_mappingClock(0)
+{
+	for(int i=0; i<MaxMappedSegments; i++) {
+		m_mappings[i].segment = -1;
+		m_mappings[i].data = 0;
+		m_mappings[i].lastUse = 0;
+	}
+}
+
+MappedHistoryBlockStore::~MappedHistoryBlockStore()
+{
+	close();
+}
+
+bool MappedHistoryBlockStore::open(const QString &path)
+{
+	close();
+	QByteArray data_path = path.toLocal8Bit();
+	m_dataFd = openUnlinked(data_path);
+	m_indexFd = openUnlinked(data_path + ".idx");
+	if(m_dataFd < 0 || m_indexFd < 0) {
+		close();
+		return false;
+	}
+	LOGDEB() << "scrollback log:" << path;
+	return true;
+}
+
+void MappedHistoryBlockStore::close()
+{
+	for(int i=0; i<MaxMappedSegments; i++) {
+		if(m_mappings[i].data)
+			::munmap(m_mappings[i].data, SegmentSize);
+		m_mappings[i].segment = -1;
+		m_mappings[i].data = 0;
+	}
+	if(m_dataFd >= 0)
+		::close(m_dataFd);
+	if(m_indexFd >= 0)
+		::close(m_indexFd);
+	m_dataFd = m_indexFd = -1;
+	m_firstBlock = m_blockCount = 0;
+	m_firstBlockOffset = m_dataSize = 0;
+	m_indexCapacity = InitialIndexCapacity;
+	m_firstSegment = 0;
+	m_segmentSlots.clear();
+	m_freeSlots.clear();
+	m_slotCount = 0;
+}
+
+bool MappedHistoryBlockStore::append(const QByteArray &block)
+{
+	if(m_dataFd < 0)
+		return false;
+	if(count() == m_indexCapacity && !growIndex()) {
+		LOGERR() << "Unable to grow scrollback index:" << ::strerror(errno);
+		return false;
+	}
+	IndexEntry entry;
+	entry.offset = m_dataSize;
+	entry.size = block.size();
+	if(entry.size > SegmentSize) {
+		LOGWARN() << "history block of" << entry.size << "bytes does not fit to log segment";
+		return false;
+	}
+	if(entry.size > 0 && entry.offset / SegmentSize != (entry.offset + entry.size - 1) / SegmentSize) {
+		// start block in the next segment, gap stays a hole in the file
+		entry.offset = (entry.offset / SegmentSize + 1) * SegmentSize;
+	}
+	qint64 segment = entry.offset / SegmentSize;
+	qint64 file_offset = static_cast<qint64>(segmentSlot(segment)) * SegmentSize + (entry.offset - segment * SegmentSize);
+	if(!writeFully(m_dataFd, block.constData(), entry.size, file_offset)
+			|| !writeFully(m_indexFd, reinterpret_cast<const char*>(&entry), sizeof(entry), indexPosition(m_blockCount))) {
+		LOGERR() << "Unable to write scrollback log:" << ::strerror(errno);
+		return false;
+	}
+	if(m_blockCount == m_firstBlock)
+		m_firstBlockOffset = entry.offset;
+	m_dataSize = entry.offset + entry.size;
+	m_blockCount++;
+	return true;
+}
+
+void MappedHistoryBlockStore::removeFirst()
+{
+	if(count() == 0)
+		return;
+	m_firstBlock++;
+	IndexEntry entry;
+	m_firstBlockOffset = (count() > 0 && readIndex(m_firstBlock, &entry))? entry.offset: m_dataSize;
+	releaseSegments();
+}
+
+QByteArray MappedHistoryBlockStore::block(int ix)
+{
+	IndexEntry entry;
+	if(ix < 0 || ix >= count() || !readIndex(m_firstBlock + ix, &entry))
+		return QByteArray();
+	qint64 segment = entry.offset / SegmentSize;
+	const uchar *data = mapSegment(segment);
+	if(!data)
+		return QByteArray();
+	// no copy, data stay in page cache
+	return QByteArray::fromRawData(reinterpret_cast<const char*>(data) + (entry.offset - segment * SegmentSize), entry.size);
+}
+
+bool MappedHistoryBlockStore::readIndex(int block_ix, IndexEntry *entry) const
+{
+	ssize_t n = ::pread(m_indexFd, entry, sizeof(*entry), indexPosition(block_ix));
+	if(n != static_cast<ssize_t>(sizeof(*entry))) {
+		LOGERR() << "Unable to read scrollback index entry" << block_ix << ::strerror(errno);
+		return false;
+	}
+	return true;
+}
+
+bool MappedHistoryBlockStore::growIndex()
+{
+	// entry of block b moves from b % capacity to b % (2 * capacity), it is the same place or the same place in upper half,
+	// so the whole ring is copied to upper half, entries left in the other half belong to blocks which are not live
+	qint64 size = static_cast<qint64>(m_indexCapacity) * sizeof(IndexEntry);
+	char buff[64 * 1024];
+	for(qint64 pos=0; pos<size; pos+=sizeof(buff)) {
+		qint64 n = qMin(static_cast<qint64>(sizeof(buff)), size - pos);
+		if(::pread(m_indexFd, buff, n, pos) != n || !writeFully(m_indexFd, buff, n, size + pos))
+			return false;
+	}
+	m_indexCapacity *= 2;
+	return true;
+}
+
+int MappedHistoryBlockStore::segmentSlot(qint64 segment)
+{
+	if(m_segmentSlots.isEmpty())
+		m_firstSegment = segment;
+	while(m_firstSegment + m_segmentSlots.count() <= segment) {
+		// file grows only when no dropped segment can be reused
+		int slot = m_freeSlots.isEmpty()? m_slotCount++: m_freeSlots.takeLast();
+		m_segmentSlots.append(slot);
+	}
+	return m_segmentSlots.at(static_cast<int>(segment - m_firstSegment));
+}
+
+void MappedHistoryBlockStore::releaseSegments()
+{
+	qint64 first_live_segment = m_firstBlockOffset / SegmentSize;
+	while(!m_segmentSlots.isEmpty() && m_firstSegment < first_live_segment) {
+		// mapping of dropped segment would show next content of its slot
+		for(int i=0; i<MaxMappedSegments; i++) {
+			Mapping &m = m_mappings[i];
+			if(m.segment == m_firstSegment) {
+				::munmap(m.data, SegmentSize);
+				m.data = 0;
+				m.segment = -1;
+			}
+		}
+		m_freeSlots.append(m_segmentSlots.takeFirst());
+		m_firstSegment++;
+	}
+}
+
+const uchar* MappedHistoryBlockStore::mapSegment(qint64 segment)
+{
+	m_mappingClock++;
+	Mapping *lru = &m_mappings[0];
+	for(int i=0; i<MaxMappedSegments; i++) {
+		Mapping &m = m_mappings[i];
+		if(m.segment == segment) {
+			m.lastUse = m_mappingClock;
+			return m.data;
+		}
+		if(m.lastUse < lru->lastUse)
+			lru = &m;
+	}
+	if(lru->data) {
+		// pages of unmapped segment are not resident any more
+		::munmap(lru->data, SegmentSize);
+		lru->data = 0;
+		lru->segment = -1;
+	}
+	// segment can be mapped behind the end of file, only written blocks are accessed
+	qint64 slot = m_segmentSlots.at(static_cast<int>(segment - m_firstSegment));
+	void *p = ::mmap(0, SegmentSize, PROT_READ, MAP_SHARED, m_dataFd, slot * SegmentSize);
+	if(p == MAP_FAILED) {
+		LOGERR() << "Unable to map scrollback log segment" << segment << ::strerror(errno);
+		return 0;
+	}
+	lru->data = static_cast<uchar*>(p);
+	lru->segment = segment;
+	lru->lastUse = m_mappingClock;
+	return lru->data;
+}
@@ -0,0 +1,83 @@
+#ifndef MAPPEDHISTORYBLOCKSTORE_H
+#define MAPPEDHISTORYBLOCKSTORE_H
+
+#include "historyblockstore.h"
+
+#include <QString>
+#include <QList>
+
+namespace core {
+namespace term {
+
+// Cold history blocks appended to a file based log, read back through mmap.
+// Log is divided to segments, block never crosses segment boundary,
+// only MaxMappedSegments are mapped at once, so resident memory does not depend on log size.
+// Log offsets grow forever, but every log segment is stored in a file slot,
+// slots of segments whose blocks were all dropped are reused, so the file holds only live segments.
+// Index file is a ring of fixed size (offset, size) entries, one for every live block,
+// so block lookup is one pread() and one page cache read.
+class MappedHistoryBlockStore : public HistoryBlockStore
+{
+public:
+	static const qint64 SegmentSize = 16 * 1024 * 1024;
+	static const int MaxMappedSegments = 4;
+	// entries, index ring doubles when it is full
+	static const int InitialIndexCapacity = 1024;
+public:
+	MappedHistoryBlockStore();
+	~MappedHistoryBlockStore();
+
+	/// creates files path and path.idx, files are unlinked immediately after they are opened,
+	/// so they are removed when the terminal exits
+	bool open(const QString &path);
+
+	int count() const Q_DECL_OVERRIDE {return m_blockCount - m_firstBlock;}
+	bool append(const QByteArray &block) Q_DECL_OVERRIDE;
+	void removeFirst() Q_DECL_OVERRIDE;
+	QByteArray block(int ix) Q_DECL_OVERRIDE;
+	qint64 byteCount() const Q_DECL_OVERRIDE {return m_dataSize - m_firstBlockOffset;}
+private:
+	struct IndexEntry
+	{
+		qint64 offset;
+		qint64 size;
+	};
+	struct Mapping
+	{
+		qint64 segment;
+		uchar *data;
+		int lastUse;
+	};
+private:
+	bool readIndex(int block_ix, IndexEntry *entry) const;
+	bool growIndex();
+	qint64 indexPosition(int block_ix) const {return static_cast<qint64>(block_ix & (m_indexCapacity - 1)) * sizeof(IndexEntry);}
+	/// file slot of log segment, new slot is assigned to segment behind the last one
+	int segmentSlot(qint64 segment);
+	/// return slots of segments before the first live block
+	void releaseSegments();
+	const uchar* mapSegment(qint64 segment);
+	void close();
+private:
+	int m_dataFd;
+	int m_indexFd;
+	// blocks before m_firstBlock are dropped
+	int m_firstBlock;
+	qint64 m_firstBlockOffset;
+	int m_blockCount;
+	// log size, not file size
+	qint64 m_dataSize;
+	int m_indexCapacity;
+	// file slots of live segments starting with m_firstSegment
+	qint64 m_firstSegment;
+	QList<int> m_segmentSlots;
+	QList<int> m_freeSlots;
+	int m_slotCount;
+	Mapping m_mappings[MaxMappedSegments];
+	int m_mappingClock;
+};
+
+}
+}
+
+#endif // MAPPEDHISTORYBLOCKSTORE_H
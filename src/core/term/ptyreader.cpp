@@ -0,0 +1,170 @@
+#include "ptyreader.h"
+#include "ptytrace.h"
+
+//#define NO_BBTERM_LOG_DEBUG
+#include <core/util/log.h>
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+
+using namespace core::term;
+
+//#define LOG_PTY_READER
+
+PtyReader::PtyReader(int master_fd, QObject *parent)
+: QThread(parent), m_masterFd(master_fd), m_chunks(ChunkCount), m_stopRequested(0), m_finished(0), m_consumerIdle(1), m_producerWaiting(0)
+, m_bytesRead(0), m_readCalls(0), m_pollCalls(0), m_wakeups(0), m_stalls(0)
+{
+	for(int i=0; i<m_chunks.capacity(); i++) {
+		Chunk &chunk = m_chunks.slotAt(i);
+		chunk.data.resize(ChunkSize);
+		chunk.size = 0;
+	}
+	if(::pipe(m_wakeFds) != 0) {
+		LOGERR() << "cannot create wake up pipe:" << ::strerror(errno);
+		m_wakeFds[0] = m_wakeFds[1] = -1;
+	}
+	// master fd is non blocking, reader waits in poll()
+	int flags = ::fcntl(m_masterFd, F_GETFL, 0);
+	::fcntl(m_masterFd, F_SETFL, flags | O_NONBLOCK);
+}
+
+PtyReader::~PtyReader()
+{
+	stop();
+	if(m_wakeFds[0] >= 0) {
+		::close(m_wakeFds[0]);
+		::close(m_wakeFds[1]);
+	}
+}
+
+void PtyReader::stop()
+{
+	if(!isRunning())
+		return;
+	m_stopRequested.fetchAndStoreOrdered(1);
+	if(m_wakeFds[1] >= 0) {
+		char c = 0;
+		ssize_t n = ::write(m_wakeFds[1], &c, 1);
+		Q_UNUSED(n);
+	}
+	m_freeChunk.release();
+	wait();
+}
+
+int PtyReader::acquire(const char **data)
+{
+	// finished must be checked before the ring, chunks published before the end of input would be lost otherwise
+	bool finished = (m_finished.fetchAndAddAcquire(0) != 0);
+	Chunk *chunk = m_chunks.readSlot();
+	if(!chunk) {
+		m_consumerIdle.fetchAndStoreOrdered(1);
+		// reader could publish a chunk before it saw the idle flag
+		chunk = m_chunks.readSlot();
+		if(!chunk)
+			return finished? -1: 0;
+		// if reader already cleared the flag, readyRead() is on the way and it will find nothing to read, that is harmless
+		m_consumerIdle.testAndSetOrdered(1, 0);
+	}
+	*data = chunk->data.constData();
+	return chunk->size;
+}
+
+void PtyReader::release()
+{
+	m_chunks.release();
+	if(m_producerWaiting.testAndSetOrdered(1, 0))
+		m_freeChunk.release();
+}
+
+void PtyReader::notifyConsumer()
+{
+	if(m_consumerIdle.testAndSetOrdered(1, 0)) {
+		m_wakeups++;
+		emit readyRead();
+	}
+}
+
+void PtyReader::waitForFreeChunk()
+{
+	m_producerWaiting.fetchAndStoreOrdered(1);
+	if(m_chunks.writeSlot()) {
+		// consumer released a chunk meanwhile, if it also cleared the flag its wake up must be consumed
+		if(!m_producerWaiting.testAndSetOrdered(1, 0))
+			m_freeChunk.acquire();
+		return;
+	}
+	m_stalls++;
+	m_freeChunk.acquire();
+}
+
+void PtyReader::run()
+{
+	struct pollfd fds[2];
+	fds[0].fd = m_masterFd;
+	fds[0].events = POLLIN;
+	fds[1].fd = m_wakeFds[0];
+	fds[1].events = POLLIN;
+	bool end_of_input = false;
+	while(!end_of_input && !m_stopRequested.fetchAndAddAcquire(0)) {
+		Chunk *chunk = m_chunks.writeSlot();
+		if(!chunk) {
+			waitForFreeChunk();
+			continue;
+		}
+		// fill the chunk as long as data are available, publish it when PTY is empty
+		chunk->size = 0;
+		char *buff = chunk->data.data();
+		while(chunk->size < ChunkSize) {
+			ssize_t n = ::read(m_masterFd, buff + chunk->size, ChunkSize - chunk->size);
+			m_readCalls++;
+			if(n > 0) {
+				PtyTrace::record(PtyTraceRead, buff + chunk->size, n);
+				chunk->size += n;
+				continue;
+			}
+			if(n < 0 && errno == EINTR)
+				continue;
+			if(n < 0 && errno == EAGAIN) {
+				if(chunk->size > 0)
+					break;
+				fds[0].revents = 0;
+				fds[1].revents = 0;
+				m_pollCalls++;
+				if(::poll(fds, (m_wakeFds[0] >= 0)? 2: 1, -1) < 0 && errno != EINTR) {
+					LOGERR() << "poll error:" << ::strerror(errno);
+					end_of_input = true;
+					break;
+				}
+				if(fds[1].revents)
+					break;
+				continue;
+			}
+			// EOF, or EIO when slave side is closed
+			end_of_input = true;
+			break;
+		}
+		if(chunk->size > 0) {
+			m_bytesRead += chunk->size;
+			m_chunks.publish();
+			notifyConsumer();
+		}
+#ifdef LOG_PTY_READER
+		if(m_bytesRead >= 16 * 1024 * 1024) {
+			double mb = m_bytesRead / (1024. * 1024.);
+			LOGDEB() << "per MB read() calls:" << (m_readCalls / mb) << "poll() calls:" << (m_pollCalls / mb)
+					 << "wake ups:" << (m_wakeups / mb) << "back-pressure stalls:" << (m_stalls / mb);
+			m_bytesRead = 0;
+			m_readCalls = m_pollCalls = m_wakeups = m_stalls = 0;
+		}
+#endif
+	}
+	if(end_of_input) {
+		m_finished.fetchAndStoreRelease(1);
+		m_consumerIdle.fetchAndStoreOrdered(1);
+		notifyConsumer();
+	}
+}
@@ -0,0 +1,72 @@
+#ifndef PTYREADER_H
+#define PTYREADER_H
+
+#include <core/util/spscring.h>
+
+#include <QThread>
+#include <QAtomicInt>
+#include <QSemaphore>
+#include <QByteArray>
+
+namespace core {
+namespace term {
+
+// Thread reading PTY master fd into preallocated chunks.
+// Chunks are passed to the parser through lock-free SPSC ring, so the kernel PTY buffer
+// is drained while the parser is busy. When all chunks are waiting for parser,
+// reader blocks (back-pressure) and the kernel buffer throttles the slave process.
+// readyRead() is emitted only when the consumer ran out of input, not for every chunk.
+class PtyReader : public QThread
+{
+	Q_OBJECT
+public:
+	static const int ChunkSize = 64 * 1024;
+	static const int ChunkCount = 16;
+public:
+	explicit PtyReader(int master_fd, QObject *parent = 0);
+	virtual ~PtyReader();
+public:
+	/// consumer side, returns size of the next chunk of input and sets data to its content,
+	/// 0 if nothing is available now (readyRead() will be emitted), -1 at the end of input
+	int acquire(const char **data);
+	/// consumer side, chunk returned by acquire() is processed and can be reused by reader
+	void release();
+	/// stop reading and wait for the thread to finish
+	void stop();
+signals:
+	void readyRead();
+protected:
+	virtual void run() Q_DECL_OVERRIDE;
+private:
+	struct Chunk
+	{
+		QByteArray data;
+		int size;
+	};
+
+	void waitForFreeChunk();
+	void notifyConsumer();
+private:
+	int m_masterFd;
+	// self-pipe to interrupt poll() in stop()
+	int m_wakeFds[2];
+	core::util::SpscRing<Chunk> m_chunks;
+	QAtomicInt m_stopRequested;
+	QAtomicInt m_finished;
+	// set by consumer when it found the ring empty, reader clears it and emits readyRead()
+	QAtomicInt m_consumerIdle;
+	// set by reader when the ring is full, consumer clears it and wakes reader by m_freeChunk
+	QAtomicInt m_producerWaiting;
+	QSemaphore m_freeChunk;
+	// statistics, touched by reader thread only
+	qint64 m_bytesRead;
+	int m_readCalls;
+	int m_pollCalls;
+	int m_wakeups;
+	int m_stalls;
+};
+
+}
+}
+
+#endif // PTYREADER_H
@@ -0,0 +1,237 @@
+#include "ptytrace.h"
+
+//#define NO_BBTERM_LOG_DEBUG
+#include <core/util/log.h>
+
+#include <QCoreApplication>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSocketNotifier>
+#include <QDir>
+#include <QFile>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+
+using namespace core::term;
+
+volatile sig_atomic_t PtyTrace::s_enabled = 0;
+
+namespace {
+
+// reader thread and GUI thread trace concurrently
+QMutex s_mutex;
+QString s_filePath;
+qint64 s_fileSize = qint64(PtyTrace::DefaultFileSizeMB) * 1024 * 1024;
+// 0 until the file is created and mapped by setEnabled()
+void *s_mapping = 0;
+// self-pipe of SIGUSR1 handler, -1 if it is not installed
+int s_signalPipe[2] = {-1, -1};
+
+PtyTraceHeader* header()
+{
+	return static_cast<PtyTraceHeader*>(s_mapping);
+}
+
+char* ring()
+{
+	return static_cast<char*>(s_mapping) + sizeof(PtyTraceHeader);
+}
+
+// position of the record following the one at pos
+uint64_t nextRecordPos(uint64_t pos)
+{
+	uint64_t capacity = header()->capacity;
+	const PtyTraceRecord *rec = reinterpret_cast<const PtyTraceRecord*>(ring() + pos);
+	pos += ptyTraceRecordSize(rec->length);
+	if(pos + sizeof(PtyTraceRecord) > capacity)
+		pos = 0;
+	return pos;
+}
+
+// move the oldest record behind ring range <from, to) which is going to be overwritten
+void evictRecords(uint64_t from, uint64_t to)
+{
+	PtyTraceHeader *h = header();
+	if(!h->wrapped)
+		return;
+	while(h->oldestPos >= from && h->oldestPos < to)
+		h->oldestPos = nextRecordPos(h->oldestPos);
+}
+
+}
+
+void PtyTrace::setFile(const QString &path, int size_mb)
+{
+	QMutexLocker locker(&s_mutex);
+	if(s_mapping) {
+		LOGWARN() << "trace file is open already, cannot change it to" << path;
+		return;
+	}
+	s_filePath = path;
+	s_fileSize = qint64(qMax(size_mb, 1)) * 1024 * 1024;
+}
+
+void PtyTrace::setEnabled(bool on)
+{
+	QMutexLocker locker(&s_mutex);
+	if(on && !s_mapping) {
+		// the next toggle tries again
+		if(!openFile())
+			on = false;
+	}
+	s_enabled = on;
+}
+
+void PtyTrace::installSignalHandler()
+{
+	if(s_signalPipe[0] >= 0)
+		return;
+	if(::pipe(s_signalPipe) != 0) {
+		LOGWARN() << "cannot create SIGUSR1 pipe:" << ::strerror(errno);
+		return;
+	}
+	for(int i=0; i<2; i++) {
+		::fcntl(s_signalPipe[i], F_SETFD, FD_CLOEXEC);
+		::fcntl(s_signalPipe[i], F_SETFL, ::fcntl(s_signalPipe[i], F_GETFL, 0) | O_NONBLOCK);
+	}
+	new PtyTraceSignalListener(s_signalPipe[0], QCoreApplication::instance());
+	struct sigaction sa;
+	::memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = onSignal;
+	sa.sa_flags = SA_RESTART;
+	::sigemptyset(&sa.sa_mask);
+	if(::sigaction(SIGUSR1, &sa, 0) != 0)
+		LOGWARN() << "cannot install SIGUSR1 handler:" << ::strerror(errno);
+}
+
+void PtyTrace::onSignal(int sig)
+{
+	Q_UNUSED(sig);
+	int saved_errno = errno;
+	char c = 0;
+	// pipe full means toggle is pending already
+	ssize_t n = ::write(s_signalPipe[1], &c, 1);
+	Q_UNUSED(n);
+	errno = saved_errno;
+}
+
+bool PtyTrace::openFile()
+{
+	int fd;
+	QString file_path = s_filePath;
+	if(file_path.isEmpty()) {
+		// unique name, runtime dir is private to user, temp dir is shared
+		QByteArray dir = qgetenv("XDG_RUNTIME_DIR");
+		if(dir.isEmpty())
+			dir = QFile::encodeName(QDir::tempPath());
+		QByteArray path = dir + "/bbterm-" + QByteArray::number(::getpid()) + "-XXXXXX";
+		// mode 0600, O_EXCL
+		fd = ::mkstemp(path.data());
+		file_path = QFile::decodeName(path);
+	}
+	else {
+		// predictable name, symlink or file planted by someone else is not followed nor truncated
+		fd = ::open(QFile::encodeName(file_path).constData(), O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW, 0600);
+	}
+	if(fd < 0) {
+		LOGERR() << "cannot create trace file" << file_path << ::strerror(errno);
+		return false;
+	}
+	::fcntl(fd, F_SETFD, FD_CLOEXEC);
+	if(::ftruncate(fd, s_fileSize) != 0) {
+		LOGERR() << "cannot resize trace file" << file_path << ::strerror(errno);
+		::close(fd);
+		// the next attempt creates it again
+		::unlink(QFile::encodeName(file_path).constData());
+		return false;
+	}
+	void *mapping = ::mmap(0, s_fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	// mapping keeps the file open
+	::close(fd);
+	if(mapping == MAP_FAILED) {
+		LOGERR() << "cannot map trace file" << file_path << ::strerror(errno);
+		::unlink(QFile::encodeName(file_path).constData());
+		return false;
+	}
+	s_mapping = mapping;
+	PtyTraceHeader *h = header();
+	::memcpy(h->magic, PTY_TRACE_MAGIC, sizeof(h->magic));
+	h->headerSize = sizeof(PtyTraceHeader);
+	h->wrapped = 0;
+	h->capacity = (s_fileSize - sizeof(PtyTraceHeader)) & ~Q_UINT64_C(7);
+	h->writePos = 0;
+	h->oldestPos = 0;
+	LOGDEB() << "PTY trace file:" << file_path;
+	return true;
+}
+
+void PtyTrace::append(PtyTraceRecordType type, const char *data, int length)
+{
+	struct timespec ts;
+	::clock_gettime(CLOCK_MONOTONIC, &ts);
+	QMutexLocker locker(&s_mutex);
+	// disabled while the record was being made
+	if(!s_mapping)
+		return;
+	PtyTraceHeader *h = header();
+	uint64_t capacity = h->capacity;
+	// huge write is truncated, it would evict most of the ring
+	uint32_t payload_length = qMin(static_cast<uint64_t>(length), capacity / 4);
+	uint64_t size = ptyTraceRecordSize(payload_length);
+	uint64_t pos = h->writePos;
+	if(pos + size > capacity) {
+		// record does not fit to the rest of the ring, pad it and wrap around
+		evictRecords(pos, capacity);
+		if(pos + sizeof(PtyTraceRecord) <= capacity) {
+			PtyTraceRecord *pad = reinterpret_cast<PtyTraceRecord*>(ring() + pos);
+			pad->nsecs = 0;
+			pad->type = PtyTracePadding;
+			pad->length = capacity - pos - sizeof(PtyTraceRecord);
+		}
+		if(!h->wrapped) {
+			h->wrapped = 1;
+			h->oldestPos = 0;
+		}
+		pos = 0;
+	}
+	evictRecords(pos, pos + size);
+	PtyTraceRecord *rec = reinterpret_cast<PtyTraceRecord*>(ring() + pos);
+	rec->nsecs = static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+	rec->length = payload_length;
+	rec->type = type;
+	::memcpy(rec + 1, data, payload_length);
+	pos += size;
+	if(pos + sizeof(PtyTraceRecord) > capacity) {
+		pos = 0;
+		if(!h->wrapped) {
+			h->wrapped = 1;
+			h->oldestPos = 0;
+		}
+	}
+	h->writePos = pos;
+}
+
+PtyTraceSignalListener::PtyTraceSignalListener(int pipe_read_fd, QObject *parent)
+: QObject(parent), m_pipeReadFd(pipe_read_fd)
+{
+	m_notifier = new QSocketNotifier(m_pipeReadFd, QSocketNotifier::Read, this);
+	connect(m_notifier, SIGNAL(activated(int)), this, SLOT(onActivated()));
+}
+
+void PtyTraceSignalListener::onActivated()
+{
+	char buff[16];
+	ssize_t n;
+	while((n = ::read(m_pipeReadFd, buff, sizeof(buff))) > 0) {
+		// every signal toggles tracing
+		for(ssize_t i=0; i<n; i++)
+			PtyTrace::setEnabled(!PtyTrace::isEnabled());
+	}
+	LOGDEB() << "PTY tracing" << (PtyTrace::isEnabled()? "enabled": "disabled");
+}
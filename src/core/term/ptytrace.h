@@ -0,0 +1,66 @@
+#ifndef PTYTRACE_H
+#define PTYTRACE_H
+
+#include "ptytraceformat.h"
+
+#include <QObject>
+#include <QString>
+#include <signal.h>
+
+class QSocketNotifier;
+
+namespace core {
+namespace term {
+
+// Raw PTY input and output with timestamps, written to ring in memory mapped file.
+// Disabled tracing costs one flag test, enabled one copies data to the mapping only,
+// so it does not distort timing being investigated. The file is decoded offline by tools/ptytrace-dump.
+// Tracing can be switched at runtime by SIGUSR1, see installSignalHandler().
+// The file is created with mode 0600 and it must not exist, an existing file or symlink is never overwritten.
+class PtyTrace
+{
+public:
+	static const int DefaultFileSizeMB = 64;
+public:
+	/// trace file, default is unique bbterm-PID-XXXXXX in $XDG_RUNTIME_DIR or temp dir,
+	/// created when tracing is enabled the first time
+	static void setFile(const QString &path, int size_mb = DefaultFileSizeMB);
+	/// creates and maps trace file if it is not mapped yet, tracing stays disabled if it fails
+	static void setEnabled(bool on);
+	static bool isEnabled() {return s_enabled;}
+	/// SIGUSR1 toggles tracing, signal is handled by event loop of the calling thread,
+	/// so it must be called after QApplication is created
+	static void installSignalHandler();
+
+	static void record(PtyTraceRecordType type, const char *data, int length)
+	{
+		if(s_enabled)
+			append(type, data, length);
+	}
+private:
+	static void append(PtyTraceRecordType type, const char *data, int length);
+	static bool openFile();
+	static void onSignal(int sig);
+private:
+	// read by append() on reader thread without locking
+	static volatile sig_atomic_t s_enabled;
+};
+
+// Signal handler only writes to a pipe, trace file is opened here on event loop,
+// open() and ftruncate() are neither async-signal-safe nor welcome on PTY reader thread.
+class PtyTraceSignalListener : public QObject
+{
+	Q_OBJECT
+public:
+	explicit PtyTraceSignalListener(int pipe_read_fd, QObject *parent = 0);
+private slots:
+	void onActivated();
+private:
+	int m_pipeReadFd;
+	QSocketNotifier *m_notifier;
+};
+
+}
+}
+
+#endif // PTYTRACE_H
@@ -0,0 +1,52 @@
+#ifndef PTYTRACEFORMAT_H
+#define PTYTRACEFORMAT_H
+
+// Binary format of PTY trace file, shared with tools/ptytrace-dump.
+// No Qt here, the dumper is a plain C++ program.
+//
+// File is a header followed by a ring of records. Record is PtyTraceRecord followed
+// by length bytes of payload padded to 8 bytes. Records never wrap around the end of the ring,
+// the rest of the ring behind the last record is filled with a padding record
+// (or left out if it is shorter than a record header).
+// When the ring is wrapped, the oldest complete record starts at oldestPos, otherwise at 0.
+// Numbers are in native byte order of the traced machine.
+
+#include <stdint.h>
+
+#define PTY_TRACE_MAGIC "BBTRACE1"
+
+enum PtyTraceRecordType
+{
+	PtyTracePadding = 0,
+	PtyTraceRead = 1,
+	PtyTraceWrite = 2
+};
+
+struct PtyTraceHeader
+{
+	char magic[8];
+	uint32_t headerSize;
+	uint32_t wrapped;
+	// size of the record ring behind the header
+	uint64_t capacity;
+	// ring offset of the next record
+	uint64_t writePos;
+	// ring offset of the oldest complete record, valid when wrapped
+	uint64_t oldestPos;
+};
+
+struct PtyTraceRecord
+{
+	// CLOCK_MONOTONIC
+	uint64_t nsecs;
+	uint32_t length;
+	uint8_t type;
+	uint8_t reserved[3];
+};
+
+static inline uint64_t ptyTraceRecordSize(uint32_t payload_length)
+{
+	return sizeof(PtyTraceRecord) + ((payload_length + 7) & ~7u);
+}
+
+#endif // PTYTRACEFORMAT_H
@@ -3,37 +3,42 @@
 #include <core/term/slaveptyprocess.h>
 
 #include <QStringList>
+#include <QTimer>
 
 //#define NO_BBTERM_LOG_DEBUG
 #include <core/util/log.h>
 
 using namespace core::term;
 
-//====================================================
-// ScreenLine
-//====================================================
-ScreenCell &ScreenLine::cellAt(int ix)
-{
-	if(ix < 0) {
-		LOGWARN() << "Internal error, cell index < 0, ix:" << ix;
-		ix = 0;
-	}
-	while(size() <= ix) {
-		append(ScreenCell());
-	}
-	return operator[](ix);
-}
-
 //====================================================
 // ScreenBuffer
 //====================================================
+int ScreenBuffer::s_defaultScrollbackDepth = ScreenBuffer::DefaultScrollbackDepth;
+QString ScreenBuffer::s_defaultScrollbackFile;
+
 ScreenBuffer::ScreenBuffer(SlavePtyProcess *slave_pty_process, QObject *parent)
-: QObject(parent), m_slavePtyProcess(slave_pty_process)
+: QObject(parent), m_lineBuffer(s_defaultScrollbackDepth, s_defaultScrollbackFile), m_alternateScreenActive(false), m_parser(this), m_slavePtyProcess(slave_pty_process)
+, m_scrollTop(0), m_scrollBottom(-1), m_lastPrintedChar(0), m_synchronizedUpdate(false)
 {
+	m_synchronizedUpdateTimer = new QTimer(this);
+	m_synchronizedUpdateTimer->setSingleShot(true);
+	m_synchronizedUpdateTimer->setInterval(SynchronizedUpdateTimeoutMs);
+	connect(m_synchronizedUpdateTimer, SIGNAL(timeout()), this, SLOT(onSynchronizedUpdateTimeout()));
 	m_currentFgColor = ScreenCell::ColorWhite;
 	m_currentBgColor = ScreenCell::ColorBlack;
 	m_currentAttributes = ScreenCell::AttrReset;
-	appendLine(true);
+	for(int i=0; i<2; i++) {
+		m_savedCursor[i].fgColor = m_currentFgColor;
+		m_savedCursor[i].bgColor = m_currentBgColor;
+		m_savedCursor[i].attributes = m_currentAttributes;
+	}
+}
+
+void ScreenBuffer::setDefaultScrollbackDepth(int lines)
+{
+	if(lines < 1)
+		lines = 1;
+	s_defaultScrollbackDepth = lines;
 }
 
 QSize ScreenBuffer::terminalSize()
@@ -45,101 +50,307 @@ void ScreenBuffer::setTerminalSize(const QSize &cols_rows)
 {
 	LOGDEB() << Q_FUNC_INFO << "from" << terminalSize().width() << terminalSize().height() << "to" << cols_rows.width() << cols_rows.height();
 	LOGDEB() << "old cursor y:" << m_cursorPosition.y();
-	int ix0 = firstVisibleLineIndex();
+	int old_rows = m_grid.rowCount();
+	int new_rows = qMax(cols_rows.height(), 0);
+	// scrolling region is reset to whole screen
+	m_scrollTop = 0;
+	m_scrollBottom = old_rows - 1;
+	// alternate screen is just cut or extended, history belongs to main screen
+	if(new_rows < old_rows && !m_alternateScreenActive) {
+		// drop blank rows below cursor first, then move rows from top to history
+		int excess = old_rows - new_rows;
+		int bottom = old_rows - 1;
+		while(excess > 0 && bottom > m_cursorPosition.y() && m_grid.isRowBlank(bottom)) {
+			bottom--;
+			excess--;
+		}
+		if(excess > 0) {
+			scrollUp(excess);
+			m_cursorPosition.ry() -= excess;
+		}
+	}
+	m_grid.resize(cols_rows.width(), new_rows);
+	m_inactiveGrid.resize(cols_rows.width(), new_rows);
+	m_scrollBottom = new_rows - 1;
+	if(new_rows > old_rows && !m_alternateScreenActive) {
+		// get lines back from history
+		int n = qMin(new_rows - old_rows, m_lineBuffer.hotCount());
+		if(n > 0) {
+			m_grid.scrollDown(0, new_rows - 1, n);
+			for(int y=n-1; y>=0; y--) {
+				const ScreenLineView line = m_lineBuffer.lineView(m_lineBuffer.count() - 1);
+				ScreenCell *cells = m_grid.row(y);
+				for(int x=0; x<line.length() && x<m_grid.columnCount(); x++)
+					cells[x] = line.at(x);
+				m_lineBuffer.removeLast();
+			}
+			m_cursorPosition.ry() += n;
+		}
+	}
 	m_terminalSize = cols_rows;
 	m_slavePtyProcess->setSize(cols_rows.width(), cols_rows.height());
-	int delta = ix0 - firstVisibleLineIndex();
-	m_cursorPosition.ry() += delta;
 	if(m_cursorPosition.y() < 0) m_cursorPosition.setY(0);
 	if(m_cursorPosition.y() >= terminalSize().height()) m_cursorPosition.setY(terminalSize().height() - 1);
+	if(m_cursorPosition.x() > terminalSize().width()) m_cursorPosition.setX(terminalSize().width());
 	LOGDEB() << "new cursor y:" << m_cursorPosition.y();
 }
 
 int ScreenBuffer::firstVisibleLineIndex() const
 {
-	int start_ix = rowCount() - m_terminalSize.height();
-	if(start_ix < 0)
-		start_ix = 0;
-	return start_ix;
-}
-
-//#define DEBUG_LTPR() {if(!line_to_print_debug.isEmpty()) {LOGDEB() << line_to_print_debug; line_to_print_debug = QString();}}
-
-void ScreenBuffer::processInput(const QString &input)
-{
-	m_inputBuffer += input;
-	//LOGDEB() << "processing input:" << input;
-	int consumed = 0;
-	QRect dirty_rect;
-	//QString line_to_print_debug;
-	while(consumed < m_inputBuffer.length()) {
-		QChar c = m_inputBuffer[consumed];
-		if(c >= ' ') {
-			//LOGDEB() << "++++" << c;
-			//line_to_print_debug += c;
-			int ix = firstVisibleLineIndex() + m_cursorPosition.y();
-			if(ix >= rowCount()) {
-				LOGERR() << "attempt to write on not existing line index" << ix << "of" << rowCount();
-			}
-			else {
-				ScreenLine &line = m_lineBuffer.at(ix);
-				ScreenCell &cell = line.cellAt(m_cursorPosition.x());
-				cell.setLetter(c);
-				cell.setColor(m_currentFgColor, m_currentBgColor);
-				cell.setAttributes(m_currentAttributes);
-			}
-			// advance cursor to next position
-			m_cursorPosition.rx()++;
-			#ifdef AUTO_LINE_FEED
-			// it seems that shell handle auto line feed itself
-			if(m_cursorPosition.x() >= terminalSize().width()) {
-				m_cursorPosition.setX(0);
-				qDebug() << "line wrap - firstVisibleLineIndex:" << firstVisibleLineIndex() << "cursor:" << m_cursorPosition.x() << m_cursorPosition.y() << "terminal size:" << terminalSize().width() << terminalSize().height();
-				appendLine(false);
-				if(m_cursorPosition.y() < (terminalSize().height() - 1)) {
-					//qDebug() << "not last terminal line";
-					m_cursorPosition.ry()++;
-				}
-				//qDebug() << "line appended - firstVisibleLineIndex:" << firstVisibleLineIndex() << "cursor.y:" << m_cursorPosition.y() << "terminal height:" << terminalSize().height();
-				//while(m_cursorPosition.y() + firstVisibleLineIndex() >= rowCount())
-			}
-			#endif
-			consumed++;
-		}
-		else {
-			//DEBUG_LTPR();
-			int seq_len = processControlSequence(consumed);
-			if(seq_len > 0) {
-				//LOGDEB() << "SEQ LEN:" << seq_len;
-				consumed += seq_len;
-			}
-			else {
-				LOGWARN() << "unrecognized escape sequence:" << m_inputBuffer.mid(consumed, 200);
-				LOGWARN() << "unrecognized escape sequence:" << m_inputBuffer.mid(consumed, 20).toLatin1().toHex();
-				consumed++;
-			}
-		}
+	return m_lineBuffer.count();
+}
+
+ScreenLineView ScreenBuffer::lineView(int ix) const
+{
+	if(ix < 0)
+		return ScreenLineView();
+	int history_count = m_lineBuffer.count();
+	if(ix < history_count)
+		return m_lineBuffer.lineView(ix);
+	ix -= history_count;
+	if(ix < m_grid.rowCount()) {
+		// trailing null cells are not part of line, the same as in history
+		const ScreenCell *cells = m_grid.row(ix);
+		int length = m_grid.columnCount();
+		while(length > 0 && cells[length - 1].isNull())
+			length--;
+		return ScreenLineView(cells, length);
 	}
-	m_inputBuffer = m_inputBuffer.mid(consumed);
-	if(consumed > 0) {
-		// TODO: implement dirty rect
-		emit dirtyRegion(dirty_rect);
+	return ScreenLineView();
+}
+
+void ScreenBuffer::processInput(const char *data, int length)
+{
+	//LOGDEB() << "processing input:" << QByteArray(data, length);
+	m_parser.process(data, length);
+	// changes of synchronized update are collected in grid dirty spans until it ends
+	if(length > 0 && !m_synchronizedUpdate) {
+		emitDirtyRegions();
 	}
-	//DEBUG_LTPR();
 	//LOGDEB() << "dump\n" << dump();
 }
 
-void ScreenBuffer::appendLine(bool move_cursor)
+void ScreenBuffer::printChar(uint c)
 {
-	//LOGDEB() << Q_FUNC_INFO;
-	m_lineBuffer.append(ScreenLine());
-	if(move_cursor) {
+	if(m_grid.isEmpty())
+		return;
+	if(c > 0xffff) {
+		// cells can hold BMP characters only
+		c = 0xfffd;
+	}
+	if(m_cursorPosition.x() >= m_grid.columnCount()) {
+		// deferred auto wrap, cursor stays behind the last column until next character is printed
 		m_cursorPosition.setX(0);
-		int new_y = qMin(rowCount(), m_terminalSize.height()) - 1;
-		if(new_y < 0)
-			new_y = 0;
-		m_cursorPosition.setY(new_y);
+		lineFeed();
+	}
+	ScreenCell &cell = m_grid.cell(m_cursorPosition.x(), m_cursorPosition.y());
+	cell.setLetter(QChar(static_cast<ushort>(c)));
+	cell.setColor(m_currentFgColor, m_currentBgColor);
+	cell.setAttributes(m_currentAttributes);
+	m_grid.setDirty(m_cursorPosition.y(), m_cursorPosition.x(), m_cursorPosition.x() + 1);
+	m_lastPrintedChar = c;
+	// advance cursor to next position
+	m_cursorPosition.rx()++;
+}
+
+void ScreenBuffer::printAscii(const char *data, int length)
+{
+	if(m_grid.isEmpty())
+		return;
+	const ScreenCell templ(QChar(), m_currentFgColor, m_currentBgColor, m_currentAttributes);
+	const int cols = m_grid.columnCount();
+	if(length > 0)
+		m_lastPrintedChar = static_cast<uchar>(data[length - 1]);
+	while(length > 0) {
+		if(m_cursorPosition.x() >= cols) {
+			m_cursorPosition.setX(0);
+			lineFeed();
+		}
+		int x = m_cursorPosition.x();
+		int n = qMin(length, cols - x);
+		ScreenCell *cells = m_grid.row(m_cursorPosition.y()) + x;
+		for(int i=0; i<n; i++) {
+			cells[i] = templ;
+			cells[i].setLetter(QChar(static_cast<ushort>(data[i])));
+		}
+		m_grid.setDirty(m_cursorPosition.y(), x, x + n);
+		m_cursorPosition.rx() += n;
+		data += n;
+		length -= n;
+	}
+}
+
+void ScreenBuffer::lineFeed()
+{
+	if(m_cursorPosition.y() == m_scrollBottom) {
+		scrollUp(1);
+	}
+	else if(m_cursorPosition.y() < m_grid.rowCount() - 1) {
+		// below the region cursor moves down to the last row
+		m_cursorPosition.ry()++;
+	}
+}
+
+void ScreenBuffer::reverseIndex()
+{
+	if(m_cursorPosition.y() == m_scrollTop) {
+		scrollDown(1);
+	}
+	else if(m_cursorPosition.y() > 0) {
+		m_cursorPosition.ry()--;
+	}
+}
+
+void ScreenBuffer::scrollUp(int n)
+{
+	int h = m_scrollBottom - m_scrollTop + 1;
+	if(n > h)
+		n = h;
+	if(n <= 0)
+		return;
+	// lines scrolled inside region (status line of editor etc.) are not history
+	if(m_scrollTop == 0 && m_scrollBottom == m_grid.rowCount() - 1) {
+		// alternate screen does not touch history, but it is blitted the same way
+		if(!m_alternateScreenActive) {
+			for(int y=0; y<n; y++)
+				m_lineBuffer.append(m_grid.row(y), m_grid.columnCount());
+		}
+		// view follows by blitting
+		m_grid.scrollScreenUp(n);
+		return;
+	}
+	// region rows are rotated, cells are not copied
+	m_grid.scrollUp(m_scrollTop, m_scrollBottom, n);
+}
+
+void ScreenBuffer::scrollDown(int n)
+{
+	// reverse index at the top of the screen (less scrolling back), view follows by blitting
+	if(m_scrollTop == 0 && m_scrollBottom == m_grid.rowCount() - 1) {
+		m_grid.scrollScreenDown(n);
+		return;
+	}
+	m_grid.scrollDown(m_scrollTop, m_scrollBottom, n);
+}
+
+void ScreenBuffer::setAlternateScreen(bool on, bool clear_alternate)
+{
+	if(on == m_alternateScreenActive)
+		return;
+	m_grid.swapCells(m_inactiveGrid);
+	m_alternateScreenActive = on;
+	// full screen applications set their own region
+	m_scrollTop = 0;
+	m_scrollBottom = m_grid.rowCount() - 1;
+	if(clear_alternate) {
+		ScreenGrid &alt = on? m_grid: m_inactiveGrid;
+		for(int y=0; y<alt.rowCount(); y++)
+			alt.clearRow(y);
+	}
+}
+
+void ScreenBuffer::setSynchronizedUpdate(bool on)
+{
+	if(on == m_synchronizedUpdate)
+		return;
+	m_synchronizedUpdate = on;
+	// repeated begin does not extend timeout, application which never ends update is not frozen
+	if(on) {
+		m_synchronizedUpdateTimer->start();
+	}
+	else {
+		m_synchronizedUpdateTimer->stop();
+		// the rest of input may begin the next update, so the finished frame is announced now
+		emitDirtyRegions();
+		emit synchronizedUpdateFinished();
+	}
+}
+
+void ScreenBuffer::onSynchronizedUpdateTimeout()
+{
+	LOGWARN() << "synchronized update not finished in" << SynchronizedUpdateTimeoutMs << "ms, releasing it";
+	m_synchronizedUpdate = false;
+	emitDirtyRegions();
+	emit synchronizedUpdateFinished();
+}
+
+void ScreenBuffer::sendReply(const QByteArray &data)
+{
+	// PTY write queues and notifier belong to GUI thread, parser can run on its own
+	QMetaObject::invokeMethod(m_slavePtyProcess, "writeReply", Qt::AutoConnection, Q_ARG(QByteArray, data));
+}
+
+void ScreenBuffer::saveCursor()
+{
+	SavedCursor &saved = m_savedCursor[m_alternateScreenActive? 1: 0];
+	saved.position = m_cursorPosition;
+	saved.fgColor = m_currentFgColor;
+	saved.bgColor = m_currentBgColor;
+	saved.attributes = m_currentAttributes;
+}
+
+void ScreenBuffer::restoreCursor()
+{
+	const SavedCursor &saved = m_savedCursor[m_alternateScreenActive? 1: 0];
+	m_cursorPosition = saved.position;
+	m_currentFgColor = saved.fgColor;
+	m_currentBgColor = saved.bgColor;
+	m_currentAttributes = saved.attributes;
+	// screen could be resized since cursor was saved
+	if(m_cursorPosition.y() >= m_grid.rowCount()) m_cursorPosition.setY(qMax(m_grid.rowCount() - 1, 0));
+	if(m_cursorPosition.x() > m_grid.columnCount()) m_cursorPosition.setX(m_grid.columnCount());
+}
+
+void ScreenBuffer::emitDirtyRegions()
+{
+	if(m_grid.isEmpty())
+		return;
+	int scrolled_lines = m_grid.scrolledLines();
+	// cursor is painted by widget, so old and new cursor cells are dirty,
+	// old cursor was moved by scroll together with the rest of the screen
+	QPoint cursor_pos = cursorPosition();
+	cursor_pos.setX(qMin(cursor_pos.x(), m_grid.columnCount() - 1));
+	m_dirtyCursorPosition.ry() -= scrolled_lines;
+	if(m_dirtyCursorPosition.y() >= 0 && m_dirtyCursorPosition.y() < m_grid.rowCount() && m_dirtyCursorPosition.x() < m_grid.columnCount())
+		m_grid.setDirty(m_dirtyCursorPosition.y(), m_dirtyCursorPosition.x(), m_dirtyCursorPosition.x() + 1);
+	m_grid.setDirty(cursor_pos.y(), cursor_pos.x(), cursor_pos.x() + 1);
+	m_dirtyCursorPosition = cursor_pos;
+
+	// coalesce dirty spans of adjacent rows while union is not much bigger than the spans
+	QRect rects[MaxDirtyRects];
+	int rect_count = 0;
+	QRect curr;
+	int curr_area = 0;
+	for(int y=0; y<=m_grid.rowCount(); y++) {
+		QRect r;
+		if(y < m_grid.rowCount()) {
+			const ScreenGrid::DirtySpan &span = m_grid.dirtySpan(y);
+			if(!span.isEmpty())
+				r = QRect(span.from, y, span.to - span.from, 1);
+		}
+		if(!curr.isNull() && !r.isNull()) {
+			QRect u = curr.united(r);
+			if(u.width() * u.height() <= 2 * (curr_area + r.width())) {
+				curr = u;
+				curr_area += r.width();
+				continue;
+			}
+		}
+		if(!curr.isNull()) {
+			if(rect_count < MaxDirtyRects)
+				rects[rect_count++] = curr;
+			else
+				rects[MaxDirtyRects - 1] = rects[MaxDirtyRects - 1].united(curr);
+		}
+		curr = r;
+		curr_area = r.width();
 	}
+	m_grid.clearDirty();
+	// scroll must be applied before dirty rects, they are relative to the scrolled screen
+	if(scrolled_lines != 0)
+		emit scrolled(scrolled_lines);
+	for(int i=0; i<rect_count; i++)
+		emit dirtyRegion(rects[i]);
 }
 
 QString ScreenBuffer::dump() const
@@ -147,7 +358,7 @@ QString ScreenBuffer::dump() const
 	QStringList lines;
 	int i0 = firstVisibleLineIndex();
 	for(int i=0; i<rowCount(); i++) {
-		lines << QString("[%1]%2").arg(i - i0, 4, 10, QChar('0')).arg(m_lineBuffer.value(i).toString());
+		lines << QString("[%1]%2").arg(i - i0, 4, 10, QChar('0')).arg(lineView(i).toString());
 	}
 	return lines.join("\n");
 }
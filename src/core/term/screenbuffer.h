@@ -1,160 +1,175 @@
 #ifndef SCREENBUFFER_H
 #define SCREENBUFFER_H
 
-#include <core/util/ringbuffer.h>
-#include <core/util/ringbuffer.h>
+#include "escapeparser.h"
+#include "screencell.h"
+#include "screengrid.h"
+#include "screenhistory.h"
 
 #include <QObject>
-#include <QSharedData>
 #include <QSize>
 #include <QPoint>
 #include <QRect>
 
+class QTimer;
+
 namespace core {
 namespace term {
 
 class SlavePtyProcess;
 
-class ScreenCell
-{
-public:
-	enum Attribute {
-		AttrReset = 0x00,
-		AttrBright = 0x01,
-		AttrDim = 0x02,
-		AttrUnderscore = 0x04,
-		AttrBlink = 0x08,
-		AttrReverse = 0x10,
-		AttrHidden = 0x20
-	};
-
-	enum Colors {
-		ColorBlack = 0,
-		ColorRed,
-		ColorGreen,
-		ColorYellow,
-		ColorBlue,
-		ColorMagenta,
-		ColorCyan,
-		ColorWhite
-	};
-
-	typedef quint8 Color;
-	typedef quint8 Attributes;
-public:
-	ScreenCell(QChar letter = '\x0', Color fg = ColorWhite, Color bg = ColorBlack, Attributes a = AttrReset)
-	: m_unicode(letter.unicode()), m_fgColor(fg), m_bgColor(bg), m_attributes(a) {}
-
-	bool isNull() const {
-		return m_unicode == 0;
-	}
-	QChar letter() const {return QChar(m_unicode);}
-	void setLetter(QChar c) {m_unicode = c.unicode();}
-	Color fgColor() const {return m_fgColor;}
-	Color bgColor() const {return m_bgColor;}
-	void setColor(Color fg, Color bg) {m_fgColor = fg; m_bgColor = bg;}
-	Attributes attributes() const {return m_attributes;}
-	void setAttributes(Attributes a) {m_attributes = a;}
-	bool isAllAttributesEqual(const ScreenCell &o) {
-		return m_fgColor == o.m_fgColor && m_bgColor == o.m_bgColor && m_attributes == o.m_attributes;
-	}
-	/*
-	int allAttributes() const {
-		return m_fgColor | (m_bgColor << 4) | (m_attributes << 8);
-	}
-	void setAllAttributes(int a) {
-		m_fgColor =  a & ~(~0 << 4);
-		m_bgColor =  (a & ~(~0 << 8)) >> 4;
-		m_attributes =  a >> 8;
-	}
-	*/
-private:
-	quint32 m_unicode:16;
-	quint32 m_fgColor:4;
-	quint32 m_bgColor:4;
-	quint32 m_attributes:8;
-};
-
-class ScreenLine : public QList<ScreenCell>
-{
-public:
-	ScreenCell& cellAt(int ix);
-	QString toString() const
-	{
-		QString ret;
-		foreach(const ScreenCell &c, *this) {
-			QChar ch = c.letter();
-			if(ch.isNull())
-				ch = ' ';
-			ret += ch;
-		}
-		return ret;
-	}
-};
-
 class ScreenBuffer : public QObject
 {
 	Q_OBJECT
+public:
+	static const int DefaultScrollbackDepth = 1024;
+	static const int MaxDirtyRects = 8;
+	// synchronized update (DECSET 2026) not finished by application in this time is released anyway
+	static const int SynchronizedUpdateTimeoutMs = 150;
 public:
 	explicit ScreenBuffer(SlavePtyProcess *slave_pty_process, QObject *parent = 0);
+
+	/// scrollback depth in lines used for new screen buffers,
+	/// lines above ScreenHistory::DefaultHotDepth are kept packed
+	static void setDefaultScrollbackDepth(int lines);
+	static int defaultScrollbackDepth() {return s_defaultScrollbackDepth;}
+	/// if set, cold scrollback of new screen buffers is unbounded and stored in memory mapped file
+	static void setDefaultScrollbackFile(const QString &path) {s_defaultScrollbackFile = path;}
 signals:
+	/// rect of changed cells, x and y are column and row of visible screen,
+	/// null rect means whole screen
 	void dirtyRegion(const QRect &rect);
+	/// whole screen content moved up by lines (down if negative), emitted before dirtyRegion() of the same update
+	void scrolled(int lines);
+	/// synchronized update ended or timed out, changes it held were emitted,
+	/// screen is consistent now, the next update may start in the same input
+	void synchronizedUpdateFinished();
+private slots:
+	void onSynchronizedUpdateTimeout();
 public:
 	void setTerminalSize(const QSize &cols_rows);
 	QSize terminalSize();
 	int rowCount() const {
-		return m_lineBuffer.count();
-	}
-	ScreenLine lineAt(int ix) {
-		return m_lineBuffer.value(ix);
+		return m_lineBuffer.count() + m_grid.rowCount();
 	}
+	/// zero copy view of line ix, lines are indexed from the oldest history line
+	ScreenLineView lineView(int ix) const;
 	int firstVisibleLineIndex() const;
 	QPoint cursorPosition() const {return m_cursorPosition;}
-	void processInput(const QString &input);
+	bool isAlternateScreenActive() const {return m_alternateScreenActive;}
+	/// screen is in the middle of synchronized update (DECSET 2026), it must not be shown
+	bool isSynchronizedUpdateActive() const {return m_synchronizedUpdate;}
+	void processInput(const char *data, int length);
 private:
-	int processControlSequence(int start_pos);
-	void appendLine(bool move_cursor);
+	/// move cursor one line down, scroll region up at its bottom line
+	void lineFeed();
+	/// move cursor one line up, scroll region down at its top line
+	void reverseIndex();
+	/// scroll scrolling region up, lines scrolled out of whole screen are moved to history
+	void scrollUp(int n);
+	/// scroll scrolling region down, blank lines appear at its top
+	void scrollDown(int n);
+	/// switch between main and alternate screen, scrollback is not touched while alternate screen is active
+	void setAlternateScreen(bool on, bool clear_alternate);
+	void saveCursor();
+	void restoreCursor();
+	void setPrivateMode(const EscapeParams &params, bool on);
+	/// while synchronized update is active, dirty regions are not emitted
+	void setSynchronizedUpdate(bool on);
+	/// send answer to terminal query to application, directly or queued to thread of SlavePtyProcess
+	void sendReply(const QByteArray &data);
+	/// emit rects of cells changed since the last call
+	void emitDirtyRegions();
 	QString dump() const;
 private:
-	core::util::RingBuffer<ScreenLine> m_lineBuffer;
-	QString m_inputBuffer;
+	static int s_defaultScrollbackDepth;
+	static QString s_defaultScrollbackFile;
+
+	ScreenHistory m_lineBuffer;
+	// active screen, main or alternate one
+	ScreenGrid m_grid;
+	// cells of inactive screen, preallocated with the same size as m_grid
+	ScreenGrid m_inactiveGrid;
+	bool m_alternateScreenActive;
+	EscapeParser m_parser;
 	QSize m_terminalSize; // cols, rows
 	SlavePtyProcess *m_slavePtyProcess;
 	QPoint m_cursorPosition;
+	// scrolling region (DECSTBM), rows are inclusive
+	int m_scrollTop;
+	int m_scrollBottom;
+	// cursor position at the last emitDirtyRegions()
+	QPoint m_dirtyCursorPosition;
 	ScreenCell::Color m_currentFgColor;
 	ScreenCell::Color m_currentBgColor;
 	ScreenCell::Attributes m_currentAttributes;
+	// the last graphic character printed, repeated by REP
+	uint m_lastPrintedChar;
+	// DECSC state, main and alternate screen have their own
+	struct SavedCursor
+	{
+		QPoint position;
+		ScreenCell::Color fgColor;
+		ScreenCell::Color bgColor;
+		ScreenCell::Attributes attributes;
+	};
+	SavedCursor m_savedCursor[2];
+	bool m_synchronizedUpdate;
+	QTimer *m_synchronizedUpdateTimer;
 public:
-	void cmdCursorMove(const QStringList &params);
-	void cmdCursorMoveRight(const QStringList &params);
-	void cmdCursorMoveDown(const QStringList &params);
-	void cmdCursorMoveLeft(const QStringList &params);
-	void cmdCursorMoveUp(const QStringList &params);
-
-	void cmdCursorSave(const QStringList &params);
-	void cmdCursorRestore(const QStringList &params);
-
-	void cmdClearToEndOfLine(const QStringList &params);
-	void cmdClearFromBeginningOfLine(const QStringList &params);
-	void cmdClearLine(const QStringList &params);
-
-	void cmdClearToEndOfScreen(const QStringList &params);
-	void cmdClearFromBeginningOfScreen(const QStringList &params);
-	void cmdClearScreen(const QStringList &params);
-
-	void cmdHorizontalTab(const QStringList &params);
-
-	void cmdSetCharAttributes(const QStringList &params);
-
-	void cmdBackSpace(const QStringList &params);
+	void cmdCursorMove(const EscapeParams &params);
+	void cmdCursorMoveRight(const EscapeParams &params);
+	void cmdCursorMoveDown(const EscapeParams &params);
+	void cmdLineFeed(const EscapeParams &params);
+	void cmdCursorMoveLeft(const EscapeParams &params);
+	void cmdCursorMoveUp(const EscapeParams &params);
+
+	void cmdCursorSave(const EscapeParams &params);
+	void cmdCursorRestore(const EscapeParams &params);
+
+	void cmdClearToEndOfLine(const EscapeParams &params);
+	void cmdClearFromBeginningOfLine(const EscapeParams &params);
+	void cmdClearLine(const EscapeParams &params);
+
+	void cmdClearToEndOfScreen(const EscapeParams &params);
+	void cmdClearFromBeginningOfScreen(const EscapeParams &params);
+	void cmdClearScreen(const EscapeParams &params);
+
+	void cmdHorizontalTab(const EscapeParams &params);
+
+	void cmdSetCharAttributes(const EscapeParams &params);
+
+	void cmdBackSpace(const EscapeParams &params);
+
+	void cmdIndex(const EscapeParams &params);
+	void cmdReverseIndex(const EscapeParams &params);
+	void cmdNextLine(const EscapeParams &params);
+	void cmdScrollUp(const EscapeParams &params);
+	void cmdScrollDown(const EscapeParams &params);
+
+	void cmdInsertLines(const EscapeParams &params);
+	void cmdDeleteLines(const EscapeParams &params);
+	void cmdInsertChars(const EscapeParams &params);
+	void cmdDeleteChars(const EscapeParams &params);
+	void cmdEraseChars(const EscapeParams &params);
+	void cmdRepeatChar(const EscapeParams &params);
+
+	void cmdDeviceAttributes(const EscapeParams &params);
+	void cmdSecondaryDeviceAttributes(const EscapeParams &params);
+	void cmdDeviceStatusReport(const EscapeParams &params);
+	void cmdTerminalVersion(const EscapeParams &params);
 public:
-	void escape_cr(const QStringList &params);
-	void escape_changeScrollingRegion(const QStringList &params);
-
-	void escape_controlSequenceCommand(const QStringList &params);
-	void escape_operatingSystemCommand(const QStringList &params);
+	void printChar(uint c);
+	void printAscii(const char *data, int length);
+	void executeControl(uint c);
+	void escapeDispatch(const EscapeParams &params);
+	void controlSequenceDispatch(const EscapeParams &params);
+	void operatingSystemCommandDispatch(const QString &osc_string);
+public:
+	void escape_cr(const EscapeParams &params);
+	void escape_changeScrollingRegion(const EscapeParams &params);
 
-	void escape_ignored(const QStringList &params);
+	void escape_ignored(const EscapeParams &params);
 };
 
 }
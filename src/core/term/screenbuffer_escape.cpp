@@ -2,108 +2,264 @@
 
 #include <core/util/log.h>
 
-#include <QStringList>
 #include <QDebug>
 
 //#define DEBUG_ESCAPES_PROCESSING
 #ifdef DEBUG_ESCAPES_PROCESSING
-#define ESC_DEBUG() qDebug() << "<CTL>" << __FUNCTION__ << "captions:" << params.join(" - ")
-#define ESC_DEBUG_IGNORED() qDebug() << "<CTL IGNORED>" << __FUNCTION__ << "captions:" << params.join(" - ")
+#define ESC_DEBUG() qDebug() << "<CTL>" << __FUNCTION__ << "params:" << params
+#define ESC_DEBUG_IGNORED() qDebug() << "<CTL IGNORED>" << __FUNCTION__ << "params:" << params
 #else
 #define ESC_DEBUG() while(false) qDebug()
 #define ESC_DEBUG_IGNORED() while(false) qDebug()
 #endif
 
-#define ESC_DEBUG_NIY() qWarning() << "<CTL NIY>" << __FUNCTION__ << "captions:" << params.join(" - ")
+#define ESC_DEBUG_NIY() qWarning() << "<CTL NIY>" << __FUNCTION__ << "params:" << params
 
 using namespace core::term;
 
-struct EscCommand
+// carriage return
+void ScreenBuffer::escape_cr(const EscapeParams &params)
 {
-	QLatin1String pattern;
-	void (ScreenBuffer::*handler)(const QStringList &);
-	bool isRegexp;
-	const char *description;
-};
-
-static EscCommand esc_commands[] = {
-	{QLatin1String("\x7"), &ScreenBuffer::escape_ignored, false, "BELL"},
-	{QLatin1String("\x8"), &ScreenBuffer::cmdBackSpace, false, "Back Space"},
-	{QLatin1String("\x9"), &ScreenBuffer::cmdHorizontalTab, false, "Horizontal tabulator"},
-	{QLatin1String("\xd""\xa"), &ScreenBuffer::cmdCursorMoveDown, false, "CRLF Move down 1 line"},
-	{QLatin1String("\xa"), &ScreenBuffer::cmdCursorMoveDown, false, "Move down 1 line"},
-	{QLatin1String("\xd"), &ScreenBuffer::escape_cr, false, "Carriage return"},
 
-	{QLatin1String("\x1b<"), &ScreenBuffer::escape_ignored, false, "Enter/exit ANSI mode (VT52) - setansi"},
-	{QLatin1String("\x1b="), &ScreenBuffer::escape_ignored, false, "Enter alternate keypad mode - altkeypad"},
-	{QLatin1String("\x1b>"), &ScreenBuffer::escape_ignored, false, "Exit alternate keypad mode - numkeypad"},
+	Q_UNUSED(params);
+	ESC_DEBUG();
+	m_cursorPosition.setX(0);
+}
 
-	{QLatin1String("\x1b""7"), &ScreenBuffer::cmdCursorSave, false, "Save cursor position and attributes"},
-	{QLatin1String("\x1b""8"), &ScreenBuffer::cmdCursorRestore, false, "Restore cursor position and attributes"},
+// Change scrolling region
+// DECSTBM, missing or 0 parameter means first and last row of screen
+void ScreenBuffer::escape_changeScrollingRegion(const EscapeParams &params)
+{
+	int rows = m_grid.rowCount();
+	int top = qMax(params.value(0), 1) - 1;
+	int bottom = (params.value(1) > 0)? params.value(1) - 1: rows - 1;
+	ESC_DEBUG() << "Enable scrolling from row:" << top << "to row:" << bottom;
+	if(top >= bottom || bottom >= rows) {
+		LOGWARN() << __FUNCTION__ << "invalid region:" << top << "-" << bottom << "rows:" << rows;
+		return;
+	}
+	m_scrollTop = top;
+	m_scrollBottom = bottom;
+	// cursor goes home, origin mode is not supported
+	m_cursorPosition = QPoint(0, 0);
+}
 
-	{QLatin1String("^\x001b([\\(\\)])([012AB])"), &ScreenBuffer::escape_ignored, true, "set character set"},
+// IND, move down one line, scroll region at its bottom
+void ScreenBuffer::cmdIndex(const EscapeParams &params)
+{
+	Q_UNUSED(params);
+	ESC_DEBUG();
+	if(m_grid.isEmpty())
+		return;
+	lineFeed();
+}
 
-	{QLatin1String("\x1b[K"), &ScreenBuffer::cmdClearToEndOfLine, false, "Clear to end of line"},
-	{QLatin1String("\x1b[0K"), &ScreenBuffer::cmdClearToEndOfLine, false, "Clear to end of line"},
-	{QLatin1String("\x1b[1K"), &ScreenBuffer::cmdClearFromBeginningOfLine, false, "Clear to beginning of line"},
-	{QLatin1String("\x1b[2K"), &ScreenBuffer::cmdClearLine, false, "Clear line"},
+// RI, move up one line, scroll region down at its top
+void ScreenBuffer::cmdReverseIndex(const EscapeParams &params)
+{
+	Q_UNUSED(params);
+	ESC_DEBUG();
+	if(m_grid.isEmpty())
+		return;
+	reverseIndex();
+}
 
-	{QLatin1String("\x1b[J"), &ScreenBuffer::cmdClearToEndOfScreen, false, ""},
-	{QLatin1String("\x1b[0J"), &ScreenBuffer::cmdClearToEndOfScreen, false, ""},
-	{QLatin1String("\x1b[1J"), &ScreenBuffer::cmdClearFromBeginningOfScreen, false, ""},
-	{QLatin1String("\x1b[2J"), &ScreenBuffer::cmdClearScreen, false, ""},
+// NEL, carriage return and index
+void ScreenBuffer::cmdNextLine(const EscapeParams &params)
+{
+	Q_UNUSED(params);
+	ESC_DEBUG();
+	if(m_grid.isEmpty())
+		return;
+	m_cursorPosition.setX(0);
+	lineFeed();
+}
 
-	{QLatin1String("^\x001b\\[([?])?(([0-9]+)?(;[0-9]*)*)([a-zA-Z])"), &ScreenBuffer::escape_controlSequenceCommand, true, "ESC [ p1;p2;... C"},
-	{QLatin1String("^\x001b\\]([0-9]+);([^\x0007]*)\x0007"), &ScreenBuffer::escape_operatingSystemCommand, true, "ESC ] p1;text ST|BEL"},
-};
-static const int esc_commands_count = sizeof(esc_commands)/sizeof(EscCommand);
+// SU, scroll region up # lines
+void ScreenBuffer::cmdScrollUp(const EscapeParams &params)
+{
+	int n = qMax(params.value(0), 1);
+	ESC_DEBUG() << "n:" << n;
+	scrollUp(n);
+}
 
-// carriage return
-void ScreenBuffer::escape_cr(const QStringList &params)
+// IL, insert # blank lines at cursor row, lines below it inside scrolling region move down
+void ScreenBuffer::cmdInsertLines(const EscapeParams &params)
 {
+	int n = qMax(params.value(0), 1);
+	ESC_DEBUG() << "n:" << n;
+	int y = m_cursorPosition.y();
+	// no effect outside of scrolling region
+	if(y < m_scrollTop || y > m_scrollBottom)
+		return;
+	// rows are rotated, not copied
+	m_grid.scrollDown(y, m_scrollBottom, n);
+	m_cursorPosition.setX(0);
+}
 
-	Q_UNUSED(params);
-	ESC_DEBUG();
+// DL, delete # lines at cursor row, lines below it inside scrolling region move up
+void ScreenBuffer::cmdDeleteLines(const EscapeParams &params)
+{
+	int n = qMax(params.value(0), 1);
+	ESC_DEBUG() << "n:" << n;
+	int y = m_cursorPosition.y();
+	if(y < m_scrollTop || y > m_scrollBottom)
+		return;
+	// deleted lines do not go to history
+	m_grid.scrollUp(y, m_scrollBottom, n);
 	m_cursorPosition.setX(0);
 }
 
-// Change scrolling region
-void ScreenBuffer::escape_changeScrollingRegion(const QStringList &params)
+// ICH, insert # blank characters at cursor
+void ScreenBuffer::cmdInsertChars(const EscapeParams &params)
 {
+	int n = qMax(params.value(0), 1);
+	ESC_DEBUG() << "n:" << n;
+	if(m_grid.isEmpty())
+		return;
+	// cursor can be behind the last column when auto wrap is pending
+	int x = qMin(m_cursorPosition.x(), m_grid.columnCount() - 1);
+	m_grid.insertCells(m_cursorPosition.y(), x, n);
+}
 
-	int n1 = params.value(1).toInt();
-	int n2 = params.value(2).toInt();
-	ESC_DEBUG() << "Enable scrolling from row:" << n1 << "to row:" << n2 << "IGNORED";
+// DCH, delete # characters at cursor, rest of line shifts left
+void ScreenBuffer::cmdDeleteChars(const EscapeParams &params)
+{
+	int n = qMax(params.value(0), 1);
+	ESC_DEBUG() << "n:" << n;
+	if(m_grid.isEmpty())
+		return;
+	int x = qMin(m_cursorPosition.x(), m_grid.columnCount() - 1);
+	m_grid.deleteCells(m_cursorPosition.y(), x, n);
 }
 
-// Move down # lines
-void ScreenBuffer::cmdCursorMoveDown(const QStringList &params)
+// ECH, erase # characters from cursor, cursor does not move
+void ScreenBuffer::cmdEraseChars(const EscapeParams &params)
 {
-	bool ok;
-	int n = params.value(1).toInt(&ok);
-	if(!ok)
-		n = 1;
-	ESC_DEBUG() << n << "lines feed";
-	int ix = firstVisibleLineIndex() + m_cursorPosition.y();
-	for(int i=0; i<n; i++) {
-		ix++;
-		if(ix >= rowCount()) {
-			appendLine(true);
-		}
-		else {
-			m_cursorPosition.rx() = 0;
-			m_cursorPosition.ry()++;
-		}
+	int n = qMax(params.value(0), 1);
+	ESC_DEBUG() << "n:" << n;
+	if(m_grid.isEmpty())
+		return;
+	int x = qMin(m_cursorPosition.x(), m_grid.columnCount() - 1);
+	m_grid.fill(m_cursorPosition.y(), x, x + n);
+}
+
+// REP, repeat the last printed character # times
+void ScreenBuffer::cmdRepeatChar(const EscapeParams &params)
+{
+	int n = qMax(params.value(0), 1);
+	ESC_DEBUG() << "n:" << n;
+	if(m_lastPrintedChar == 0)
+		return;
+	// more repeats would overwrite the same screen again
+	n = qMin(n, m_grid.columnCount() * m_grid.rowCount());
+	for(int i=0; i<n; i++)
+		printChar(m_lastPrintedChar);
+}
+
+// version reported by XTVERSION and DA2, keep in sync with bar-descriptor.xml
+static const char TerminalVersion[] = "1.0.0";
+static const int TerminalVersionNumber = 100;
+
+// DA1, VT100 with advanced video option, the same as xterm with TERM=xterm
+void ScreenBuffer::cmdDeviceAttributes(const EscapeParams &params)
+{
+	ESC_DEBUG();
+	if(params.value(0) != 0)
+		return;
+	sendReply("\033[?1;2c");
+}
+
+// DA2, terminal type 0 (VT100), firmware version, ROM cartridge 0
+void ScreenBuffer::cmdSecondaryDeviceAttributes(const EscapeParams &params)
+{
+	ESC_DEBUG();
+	if(params.value(0) != 0)
+		return;
+	sendReply(QByteArray("\033[>0;") + QByteArray::number(TerminalVersionNumber) + ";0c");
+}
+
+// DSR, operating status or cursor position report (CPR), DEC form has '?' marker
+void ScreenBuffer::cmdDeviceStatusReport(const EscapeParams &params)
+{
+	ESC_DEBUG();
+	bool dec = (params.privateMarker() == '?');
+	switch(params.value(0)) {
+	case 5:
+		sendReply("\033[0n");
+		break;
+	case 6: {
+		// cursor behind the last column with pending wrap is reported in the last column
+		int x = qMax(qMin(m_cursorPosition.x(), m_grid.columnCount() - 1), 0);
+		QByteArray reply = "\033[";
+		if(dec)
+			reply += '?';
+		reply += QByteArray::number(m_cursorPosition.y() + 1);
+		reply += ';';
+		reply += QByteArray::number(x + 1);
+		if(dec)
+			reply += ";1";
+		reply += 'R';
+		sendReply(reply);
+		break;
+	}
+	default:
+		ESC_DEBUG_IGNORED();
+		break;
 	}
 }
 
+// XTVERSION, name and version as DCS > | text ST
+void ScreenBuffer::cmdTerminalVersion(const EscapeParams &params)
+{
+	ESC_DEBUG();
+	if(params.value(0) != 0)
+		return;
+	sendReply(QByteArray("\033P>|bbterm(") + TerminalVersion + ")\033\\");
+}
+
+// SD, scroll region down # lines
+void ScreenBuffer::cmdScrollDown(const EscapeParams &params)
+{
+	int n = qMax(params.value(0), 1);
+	ESC_DEBUG() << "n:" << n;
+	scrollDown(n);
+}
+
+// LF, VT and FF, scroll region at its bottom line
+void ScreenBuffer::cmdLineFeed(const EscapeParams &params)
+{
+	Q_UNUSED(params);
+	ESC_DEBUG();
+	if(m_grid.isEmpty())
+		return;
+	lineFeed();
+	m_cursorPosition.setX(0);
+}
+
+// CUD, move down # lines, cursor stops at bottom margin, it never scrolls
+void ScreenBuffer::cmdCursorMoveDown(const EscapeParams &params)
+{
+	int n = params.value(0);
+	if(n == 0) n = 1;
+	ESC_DEBUG() << "n:" << n;
+	if(m_grid.isEmpty())
+		return;
+	// below the region cursor can move down to the last row
+	int bottom = (m_cursorPosition.y() <= m_scrollBottom)? m_scrollBottom: m_grid.rowCount() - 1;
+	m_cursorPosition.setY(qMin(m_cursorPosition.y() + n, bottom));
+	// pending auto wrap is cancelled, column is kept
+	m_cursorPosition.setX(qMin(m_cursorPosition.x(), m_grid.columnCount() - 1));
+}
+
 // Move cursor left #1 spaces
-void ScreenBuffer::cmdCursorMoveLeft(const QStringList &params)
+void ScreenBuffer::cmdCursorMoveLeft(const EscapeParams &params)
 {
-	int n = params.value(1).toInt();
+	int n = params.value(0);
 	if(n == 0) n = 1;
 	ESC_DEBUG() << "n:" << n;
-	int x = m_cursorPosition.x() - n;
+	// cursor can be behind the last column when auto wrap is pending
+	int x = qMin(m_cursorPosition.x(), m_grid.columnCount() - 1) - n;
 	if(x < 0) {
 		x = 0;
 	}
@@ -112,9 +268,9 @@ void ScreenBuffer::cmdCursorMoveLeft(const QStringList &params)
 
 // Move right # spaces
 // The CUF sequence moves the active position to the right. The distance moved is determined by the parameter. A parameter value of zero or one moves the active position one position to the right. A parameter value of n moves the active position n positions to the right. If an attempt is made to move the cursor to the right of the right margin, the cursor stops at the right margin.
-void ScreenBuffer::cmdCursorMoveRight(const QStringList &params)
+void ScreenBuffer::cmdCursorMoveRight(const EscapeParams &params)
 {
-	int n = params.value(1).toInt();
+	int n = params.value(0);
 	if(n == 0) n = 1;
 	ESC_DEBUG() << "n:" << n;
 	int x = m_cursorPosition.x() + n;
@@ -125,19 +281,13 @@ void ScreenBuffer::cmdCursorMoveRight(const QStringList &params)
 }
 
 // Move to row #1 col #2
-void ScreenBuffer::cmdCursorMove(const QStringList &params)
+void ScreenBuffer::cmdCursorMove(const EscapeParams &params)
 {
-	bool ok;
-	int row = params.value(1).toInt(&ok) - 1;
-	if(!ok) row = 0;
-	int col = params.value(2).toInt(&ok) - 1;
-	if(!ok) col = 0;
+	int row = qMax(params.value(0), 1) - 1;
+	int col = qMax(params.value(1), 1) - 1;
 	ESC_DEBUG() << "move cursor to row:" << row << "col:" << col;
 	if(row >= 0 && row < m_terminalSize.height()) {
 		if(col >= 0 && col < m_terminalSize.width()) {
-			while(rowCount() <= row) {
-				appendLine(false);
-			}
 			m_cursorPosition.setX(col);
 			m_cursorPosition.setY(row);
 		}
@@ -151,133 +301,160 @@ void ScreenBuffer::cmdCursorMove(const QStringList &params)
 }
 
 // Move cursor up #1 lines
-void ScreenBuffer::cmdCursorMoveUp(const QStringList &params)
+void ScreenBuffer::cmdCursorMoveUp(const EscapeParams &params)
 {
-	int n = params.value(1).toInt();
+	int n = params.value(0);
 	if(n == 0) n = 1;
 	ESC_DEBUG() << "n:" << n;
+	// above the region cursor can move up to the first row
+	int top = (m_cursorPosition.y() >= m_scrollTop)? m_scrollTop: 0;
 	int y = m_cursorPosition.y() - n;
-	if(y < 0) { y = 0; }
+	if(y < top) { y = top; }
 	m_cursorPosition.setY(y);
 }
 
 // Clear to end of display
-void ScreenBuffer::cmdClearToEndOfScreen(const QStringList &params)
+void ScreenBuffer::cmdClearToEndOfScreen(const EscapeParams &params)
 {
 	Q_UNUSED(params);
 	ESC_DEBUG();
 	QPoint pos = m_cursorPosition;
-	cmdClearToEndOfLine(QStringList());
+	cmdClearToEndOfLine(params);
 	for(int y = pos.y() + 1; y<m_terminalSize.height(); y++) {
 		m_cursorPosition.setX(0);
 		m_cursorPosition.setY(y);
-		cmdClearToEndOfLine(QStringList());
+		cmdClearToEndOfLine(params);
 	}
 	m_cursorPosition = pos;
 }
 
-void ScreenBuffer::cmdClearFromBeginningOfScreen(const QStringList &params)
+void ScreenBuffer::cmdClearFromBeginningOfScreen(const EscapeParams &params)
 {
 	Q_UNUSED(params);
 	ESC_DEBUG();
 	QPoint pos = m_cursorPosition;
-	cmdClearFromBeginningOfLine(QStringList());
+	cmdClearFromBeginningOfLine(params);
 	for(int y = 0; y<pos.y(); y++) {
 		m_cursorPosition.setX(0);
 		m_cursorPosition.setY(y);
-		cmdClearToEndOfLine(QStringList());
+		cmdClearToEndOfLine(params);
 	}
 	m_cursorPosition = pos;
 }
 
-void ScreenBuffer::cmdClearScreen(const QStringList &params)
+void ScreenBuffer::cmdClearScreen(const EscapeParams &params)
 {
 	Q_UNUSED(params);
 	ESC_DEBUG();
 	m_cursorPosition = QPoint(0, 0);
-	cmdClearToEndOfScreen(QStringList());
+	cmdClearToEndOfScreen(params);
 }
 
 // Clear to end of line
-void ScreenBuffer::cmdClearToEndOfLine(const QStringList &params)
+void ScreenBuffer::cmdClearToEndOfLine(const EscapeParams &params)
 {
 	Q_UNUSED(params);
 	ESC_DEBUG();
-	int row = firstVisibleLineIndex() + m_cursorPosition.y();
-	if(row < rowCount()) {
-		ScreenLine &line = m_lineBuffer.at(row);
-		for(int i=m_cursorPosition.x(); i<m_terminalSize.width() && i<line.length(); i++) {
-			ScreenCell &cell = line.cellAt(i);
-			cell.setLetter(QChar());
-			cell.setColor(ScreenCell::ColorWhite, ScreenCell::ColorBlack);
-			cell.setAttributes(ScreenCell::AttrReset);
-		}
-	}
+	if(m_cursorPosition.y() < m_grid.rowCount())
+		m_grid.fill(m_cursorPosition.y(), m_cursorPosition.x(), m_grid.columnCount());
 }
 
 // Clear from beginning of line to cursor
-void ScreenBuffer::cmdClearFromBeginningOfLine(const QStringList &params)
+void ScreenBuffer::cmdClearFromBeginningOfLine(const EscapeParams &params)
 {
 	Q_UNUSED(params);
 	ESC_DEBUG() << "Clear from beginning of line to cursor";
-	int row = firstVisibleLineIndex() + m_cursorPosition.y();
-	if(row < rowCount()) {
-		ScreenLine &line = m_lineBuffer.at(row);
-		for(int i=0; i<=m_cursorPosition.x(); i++) {
-			ScreenCell &cell = line.cellAt(i);
-			cell.setLetter(QChar());
-			cell.setColor(ScreenCell::ColorWhite, ScreenCell::ColorBlack);
-			cell.setAttributes(ScreenCell::AttrReset);
-		}
-	}
+	if(m_cursorPosition.y() < m_grid.rowCount())
+		m_grid.fill(m_cursorPosition.y(), 0, m_cursorPosition.x() + 1);
 }
 
-void ScreenBuffer::cmdClearLine(const QStringList &params)
+void ScreenBuffer::cmdClearLine(const EscapeParams &params)
 {
 	Q_UNUSED(params);
 	ESC_DEBUG() << "Clear line";
-	int row = firstVisibleLineIndex() + m_cursorPosition.y();
-	if(row < rowCount()) {
-		ScreenLine &line = m_lineBuffer.at(row);
-		for(int i=0; i<=line.length(); i++) {
-			ScreenCell &cell = line.cellAt(i);
-			cell.setLetter(QChar());
-			cell.setColor(ScreenCell::ColorWhite, ScreenCell::ColorBlack);
-			cell.setAttributes(ScreenCell::AttrReset);
-		}
-	}
+	if(m_cursorPosition.y() < m_grid.rowCount())
+		m_grid.clearRow(m_cursorPosition.y());
 }
 
-void ScreenBuffer::cmdCursorSave(const QStringList &params)
+// DECSC, save cursor position and character attributes
+void ScreenBuffer::cmdCursorSave(const EscapeParams &params)
 {
 	Q_UNUSED(params);
-	ESC_DEBUG_IGNORED();
+	ESC_DEBUG();
+	saveCursor();
 }
 
-void ScreenBuffer::cmdCursorRestore(const QStringList &params)
+// DECRC
+void ScreenBuffer::cmdCursorRestore(const EscapeParams &params)
 {
 	Q_UNUSED(params);
-	ESC_DEBUG_IGNORED();
+	ESC_DEBUG();
+	restoreCursor();
+}
+
+// DECSET/DECRST, more modes can be set by one sequence
+void ScreenBuffer::setPrivateMode(const EscapeParams &params, bool on)
+{
+	for(int i=0; i<params.count(); i++) {
+		int mode = params.value(i);
+		switch(mode) {
+		case 47:
+			// alternate screen
+			setAlternateScreen(on, false);
+			break;
+		case 1047:
+			// alternate screen, cleared when leaving it
+			setAlternateScreen(on, !on);
+			break;
+		case 1048:
+			if(on)
+				saveCursor();
+			else
+				restoreCursor();
+			break;
+		case 1049:
+			// save cursor, switch to cleared alternate screen and back, used by vim, less, htop, ...
+			if(on) {
+				saveCursor();
+				setAlternateScreen(true, true);
+			}
+			else {
+				setAlternateScreen(false, false);
+				restoreCursor();
+			}
+			break;
+		case 2026:
+			// begin and end of application frame, it is painted at once
+			setSynchronizedUpdate(on);
+			break;
+		default:
+			ESC_DEBUG_IGNORED() << "DEC Private Mode" << mode << on;
+			break;
+		}
+	}
 }
 
 // tab to next 8-space hardware tab stop
-void ScreenBuffer::cmdHorizontalTab(const QStringList &params)
+void ScreenBuffer::cmdHorizontalTab(const EscapeParams &params)
 {
 	Q_UNUSED(params);
 	static const int tab_width = 8;
 	int x = m_cursorPosition.x();
 	x = (x / tab_width + 1) * tab_width;
-	m_cursorPosition.setX(x);
-	if(m_cursorPosition.x() >= m_terminalSize.width()) {
-		//appendLine();
-	}
+	// tab stops at the right margin
+	if(x >= m_terminalSize.width())
+		x = m_terminalSize.width() - 1;
+	if(x > m_cursorPosition.x())
+		m_cursorPosition.setX(x);
 }
 
 // backspace key
-void ScreenBuffer::cmdBackSpace(const QStringList &params)
+void ScreenBuffer::cmdBackSpace(const EscapeParams &params)
 {
 	Q_UNUSED(params);
 	ESC_DEBUG();
+	if(m_cursorPosition.x() >= m_terminalSize.width())
+		m_cursorPosition.setX(m_terminalSize.width() - 1);
 	m_cursorPosition.rx()--;
 	if(m_cursorPosition.x() < 0) {
 		m_cursorPosition.ry()--;
@@ -286,20 +463,81 @@ void ScreenBuffer::cmdBackSpace(const QStringList &params)
 			m_cursorPosition.ry() = 0;
 	}
 	#ifdef BACKSPACE_DELETES
-	int row = firstVisibleLineIndex() + m_cursorPosition.y();
-	if(row < rowCount()) {
-		ScreenLine &line = m_lineBuffer.at(row);
-		ScreenCell &cell = line.cellAt(m_cursorPosition.x());
+	if(m_cursorPosition.y() < m_grid.rowCount()) {
+		ScreenCell &cell = m_grid.cell(m_cursorPosition.x(), m_cursorPosition.y());
 		cell.setLetter(QChar());
+		m_grid.setDirty(m_cursorPosition.y(), m_cursorPosition.x(), m_cursorPosition.x() + 1);
 	}
 	#endif
 }
 
-void ScreenBuffer::cmdSetCharAttributes(const QStringList &params)
+// Convert 256 colors index or RGB color to nearest of 8 colors
+// ISO 8613-6 form: 38:5:ix, 38:2::r:g:b or xterm form: 38;5;ix, 38;2;r;g;b
+// param_ix is moved to last consumed parameter
+static int extendedColor(const EscapeParams &params, int *param_ix)
+{
+	int ix = *param_ix;
+	int type, r, g, b;
+	if(params.subParamCount(ix) > 0) {
+		type = params.subParam(ix, 1);
+		if(type == 5) {
+			r = params.subParam(ix, 2, -1);
+			g = b = -1;
+		}
+		else {
+			// color space id is optional
+			int first = (params.subParamCount(ix) >= 5)? 3: 2;
+			r = params.subParam(ix, first);
+			g = params.subParam(ix, first + 1);
+			b = params.subParam(ix, first + 2);
+		}
+	}
+	else {
+		type = params.value(ix + 1);
+		if(type == 5) {
+			r = params.value(ix + 2, -1);
+			g = b = -1;
+			*param_ix = ix + 2;
+		}
+		else {
+			r = params.value(ix + 2);
+			g = params.value(ix + 3);
+			b = params.value(ix + 4);
+			*param_ix = ix + 4;
+		}
+	}
+	if(type == 5) {
+		int n = r;
+		if(n < 0)
+			return -1;
+		if(n < 16)
+			return n & 7;
+		if(n < 232) {
+			// 6x6x6 color cube
+			n -= 16;
+			r = (n / 36) * 51;
+			g = ((n / 6) % 6) * 51;
+			b = (n % 6) * 51;
+		}
+		else {
+			// grayscale ramp
+			r = g = b = (n - 232) * 10 + 8;
+		}
+	}
+	else if(type != 2) {
+		LOGWARN() << "invalid extended color type:" << type;
+		return -1;
+	}
+	return ((r > 127)? ScreenCell::ColorRed: 0) | ((g > 127)? ScreenCell::ColorGreen: 0) | ((b > 127)? ScreenCell::ColorBlue: 0);
+}
+
+void ScreenBuffer::cmdSetCharAttributes(const EscapeParams &params)
 {
 	ESC_DEBUG();
-	foreach(QString param, params) {
-		int n = param.toInt();
+	// CSI m is the same as CSI 0 m
+	int cnt = qMax(params.count(), 1);
+	for(int i=0; i<cnt; i++) {
+		int n = params.value(i);
 		switch(n) {
 		case 0:
 			m_currentAttributes = 0;
@@ -322,6 +560,17 @@ void ScreenBuffer::cmdSetCharAttributes(const QStringList &params)
 		case 8:
 			m_currentAttributes |= ScreenCell::AttrHidden;
 			break;
+		case 38:
+		case 48: {
+			int color = extendedColor(params, &i);
+			if(color >= 0) {
+				if(n == 38)
+					m_currentFgColor = color;
+				else
+					m_currentBgColor = color;
+			}
+			break;
+		}
 		default:
 			if(n >= 30 && n <= 39) {
 				n -= 30;
@@ -346,113 +595,158 @@ void ScreenBuffer::cmdSetCharAttributes(const QStringList &params)
 	}
 }
 
-void ScreenBuffer::escape_ignored(const QStringList &params)
+void ScreenBuffer::escape_ignored(const EscapeParams &params)
 {
 	Q_UNUSED(params);
 	ESC_DEBUG_IGNORED();
 }
 
-void ScreenBuffer::escape_controlSequenceCommand(const QStringList &params)
+// C0 and C1 control characters
+void ScreenBuffer::executeControl(uint c)
 {
-	ESC_DEBUG();
-	QString cmd_str = params.value(5);
-	if(cmd_str.isEmpty()) {
-		LOGWARN() << "internal error: empty command, this should never happen";
+	static const EscapeParams params;
+	switch(c) {
+	case 0x07: escape_ignored(params); break; // BELL
+	case 0x08: cmdBackSpace(params); break;
+	case 0x09: cmdHorizontalTab(params); break;
+	case 0x0a: // LF
+	case 0x0b: // VT
+	case 0x0c: // FF
+		cmdLineFeed(params);
+		break;
+	case 0x0d: escape_cr(params); break;
+	case 0x0e: // SO
+	case 0x0f: // SI
+		escape_ignored(params);
+		break;
+	default:
+		ESC_DEBUG_IGNORED() << "control character:" << c;
+		break;
+	}
+}
+
+// ESC [intermediates] final_char
+void ScreenBuffer::escapeDispatch(const EscapeParams &params)
+{
+	const char *intermediates = params.intermediates();
+	char final_char = params.finalChar();
+	if(intermediates[0] == 0) {
+		switch(final_char) {
+		case '7': cmdCursorSave(params); break;
+		case '8': cmdCursorRestore(params); break;
+		case '<': ESC_DEBUG_IGNORED() << "Enter/exit ANSI mode (VT52) - setansi"; break;
+		case '=': ESC_DEBUG_IGNORED() << "Enter alternate keypad mode - altkeypad"; break;
+		case '>': ESC_DEBUG_IGNORED() << "Exit alternate keypad mode - numkeypad"; break;
+		case 'D': cmdIndex(params); break;
+		case 'E': cmdNextLine(params); break;
+		case 'M': cmdReverseIndex(params); break;
+		case '\\': break; // String Terminator
+		default: ESC_DEBUG_NIY(); break;
+		}
 	}
 	else {
-		QString mod = params.value(1);
-		QStringList captions;
-		captions << params.value(0) << params.value(2).split(';');
-		int cmd = cmd_str[0].unicode();
-		if(mod.isEmpty()) {
-			switch(cmd) {
-			case 'A': cmdCursorMoveUp(captions); break;
-			case 'B': cmdCursorMoveDown(captions); break;
-			case 'C': cmdCursorMoveRight(captions); break;
-			case 'D': cmdCursorMoveLeft(captions); break;
-			case 'H': cmdCursorMove(captions); break;
-			case 'h': ESC_DEBUG_IGNORED() << "Set Mode (SM)"; break;
-			case 'l': ESC_DEBUG_IGNORED() << "Reset Mode (RM)"; break;
-			case 'm': cmdSetCharAttributes(captions); break;
-			case 'r': ESC_DEBUG_IGNORED() << "Set top and bottom lines of a window"; break;
+		switch(intermediates[0]) {
+		case '(':
+		case ')':
+		case '*':
+		case '+':
+			ESC_DEBUG_IGNORED() << "set character set";
+			break;
+		default:
+			ESC_DEBUG_NIY();
+			break;
+		}
+	}
+}
+
+// CSI [private_marker] p1;p2;... [intermediates] final_char
+void ScreenBuffer::controlSequenceDispatch(const EscapeParams &params)
+{
+	char final_char = params.finalChar();
+	if(params.intermediates()[0] != 0) {
+		ESC_DEBUG_NIY();
+	}
+	else if(params.privateMarker() == 0) {
+		switch(final_char) {
+		case '@': cmdInsertChars(params); break;
+		case 'A': cmdCursorMoveUp(params); break;
+		case 'B': cmdCursorMoveDown(params); break;
+		case 'C': cmdCursorMoveRight(params); break;
+		case 'D': cmdCursorMoveLeft(params); break;
+		case 'H': cmdCursorMove(params); break;
+		case 'J':
+			switch(params.value(0)) {
+			case 0: cmdClearToEndOfScreen(params); break;
+			case 1: cmdClearFromBeginningOfScreen(params); break;
+			case 2: cmdClearScreen(params); break;
 			default: ESC_DEBUG_NIY(); break;
 			}
-		}
-		else if(mod == "?") {
-			switch(cmd) {
-			case 'h': ESC_DEBUG_IGNORED() << "DEC Private Mode Set (DECSET)"; break;
-			case 'l': ESC_DEBUG_IGNORED() << "DEC Private Mode Reset (DECRST)"; break;
-			case 's': ESC_DEBUG_IGNORED() << "Save DEC Private Mode Values. Ps values are the same as for DECSET."; break;
+			break;
+		case 'K':
+			switch(params.value(0)) {
+			case 0: cmdClearToEndOfLine(params); break;
+			case 1: cmdClearFromBeginningOfLine(params); break;
+			case 2: cmdClearLine(params); break;
 			default: ESC_DEBUG_NIY(); break;
 			}
+			break;
+		case 'L': cmdInsertLines(params); break;
+		case 'M': cmdDeleteLines(params); break;
+		case 'P': cmdDeleteChars(params); break;
+		case 'X': cmdEraseChars(params); break;
+		case 'b': cmdRepeatChar(params); break;
+		case 'c': cmdDeviceAttributes(params); break;
+		case 'h': ESC_DEBUG_IGNORED() << "Set Mode (SM)"; break;
+		case 'l': ESC_DEBUG_IGNORED() << "Reset Mode (RM)"; break;
+		case 'm': cmdSetCharAttributes(params); break;
+		case 'n': cmdDeviceStatusReport(params); break;
+		case 'r': escape_changeScrollingRegion(params); break;
+		case 'S': cmdScrollUp(params); break;
+		case 'T': cmdScrollDown(params); break;
+		default: ESC_DEBUG_NIY(); break;
 		}
-		else {
-			LOGWARN() << "internal error: unknown mode command:" << mod << "- this should never happen";
+	}
+	else if(params.privateMarker() == '?') {
+		switch(final_char) {
+		case 'h': setPrivateMode(params, true); break;
+		case 'l': setPrivateMode(params, false); break;
+		case 'n': cmdDeviceStatusReport(params); break;
+		case 's': ESC_DEBUG_IGNORED() << "Save DEC Private Mode Values. Ps values are the same as for DECSET."; break;
+		default: ESC_DEBUG_NIY(); break;
 		}
 	}
-}
-
-void ScreenBuffer::escape_operatingSystemCommand(const QStringList &params)
-{
-	ESC_DEBUG();
-	QString cmd_str = params.value(1);
-	if(cmd_str.isEmpty()) {
-		LOGWARN() << "internal error: empty command, this should never happen";
+	else if(params.privateMarker() == '>') {
+		switch(final_char) {
+		case 'c': cmdSecondaryDeviceAttributes(params); break;
+		case 'q': cmdTerminalVersion(params); break;
+		default: ESC_DEBUG_NIY(); break;
+		}
 	}
 	else {
-		int cmd = cmd_str.toInt();
-		QString text_param = params.value(2);
-		ESC_DEBUG_IGNORED() << cmd << text_param;
+		ESC_DEBUG_NIY();
 	}
 }
 
-static QMap<QString, QRegExp> seqRegExps;
-
-int ScreenBuffer::processControlSequence(int start_pos)
-{
-	EscCommand *cmds = esc_commands;
-	int cmdn = esc_commands_count;
-	QStringList params;
-	int cmd_index = -1;
-	int matched_length = -1;
-	for(int i=0; i<cmdn; i++) {
-		EscCommand cmd = cmds[i];
-		QLatin1String pattern = cmd.pattern;
-		if(cmd.isRegexp) {
-			QRegExp rx = seqRegExps.value(pattern);
-			if(rx.isEmpty()) {
-				rx = QRegExp(pattern);
-				if(!rx.isValid()) {
-					LOGWARN() << "Invalid escapesequence" << pattern;
-				}
-				seqRegExps[pattern] = rx;
-			}
-			if(rx.indexIn(m_inputBuffer, start_pos, QRegExp::CaretAtOffset) == start_pos) {
-				cmd_index = i;
-				params = rx.capturedTexts();
-				matched_length = rx.matchedLength();
-				break;
-			}
-		}
-		else {
-			QStringRef str_ref(&m_inputBuffer, start_pos, m_inputBuffer.length() - start_pos);
-			if(str_ref.startsWith(pattern)) {
-				cmd_index = i;
-				QString param = m_inputBuffer.mid(start_pos, ::strlen(pattern.latin1()));
-				matched_length = param.length();
-				params << param;
-				break;
-			}
+// OSC p1;text ST|BEL
+void ScreenBuffer::operatingSystemCommandDispatch(const QString &osc_string)
+{
+	int ix = osc_string.indexOf(';');
+	int cmd = 0;
+	for(int i=0; i<ix; i++) {
+		QChar c = osc_string[i];
+		if(!c.isDigit()) {
+			LOGWARN() << "invalid operating system command:" << osc_string;
+			return;
 		}
+		cmd = cmd * 10 + (c.unicode() - '0');
 	}
-	if(cmd_index >= 0) {
-		/*
-		if(matched_length > 50) {
-			LOGWARN() << "################" << params.value(0);
-		}
-		*/
-		(*this.*(cmds[cmd_index].handler))(params);
-		return matched_length;
+	if(ix < 0) {
+		LOGWARN() << "invalid operating system command:" << osc_string;
+	}
+	else {
+		// ESC_DEBUG_IGNORED() logs params
+		const QString &params = osc_string;
+		Q_UNUSED(params);
+		ESC_DEBUG_IGNORED() << cmd;
 	}
-	return 0;
 }
@@ -0,0 +1,76 @@
+#ifndef SCREENCELL_H
+#define SCREENCELL_H
+
+#include <QChar>
+#include <QtGlobal>
+
+namespace core {
+namespace term {
+
+class ScreenCell
+{
+public:
+	enum Attribute {
+		AttrReset = 0x00,
+		AttrBright = 0x01,
+		AttrDim = 0x02,
+		AttrUnderscore = 0x04,
+		AttrBlink = 0x08,
+		AttrReverse = 0x10,
+		AttrHidden = 0x20
+	};
+
+	enum Colors {
+		ColorBlack = 0,
+		ColorRed,
+		ColorGreen,
+		ColorYellow,
+		ColorBlue,
+		ColorMagenta,
+		ColorCyan,
+		ColorWhite
+	};
+
+	typedef quint8 Color;
+	typedef quint8 Attributes;
+public:
+	ScreenCell(QChar letter = '\x0', Color fg = ColorWhite, Color bg = ColorBlack, Attributes a = AttrReset)
+	: m_unicode(letter.unicode()), m_fgColor(fg), m_bgColor(bg), m_attributes(a) {}
+
+	bool isNull() const {
+		return m_unicode == 0;
+	}
+	QChar letter() const {return QChar(m_unicode);}
+	void setLetter(QChar c) {m_unicode = c.unicode();}
+	Color fgColor() const {return m_fgColor;}
+	Color bgColor() const {return m_bgColor;}
+	void setColor(Color fg, Color bg) {m_fgColor = fg; m_bgColor = bg;}
+	Attributes attributes() const {return m_attributes;}
+	void setAttributes(Attributes a) {m_attributes = a;}
+	bool isAllAttributesEqual(const ScreenCell &o) const {
+		return m_fgColor == o.m_fgColor && m_bgColor == o.m_bgColor && m_attributes == o.m_attributes;
+	}
+	/*
+	int allAttributes() const {
+		return m_fgColor | (m_bgColor << 4) | (m_attributes << 8);
+	}
+	void setAllAttributes(int a) {
+		m_fgColor =  a & ~(~0 << 4);
+		m_bgColor =  (a & ~(~0 << 8)) >> 4;
+		m_attributes =  a >> 8;
+	}
+	*/
+private:
+	quint32 m_unicode:16;
+	quint32 m_fgColor:4;
+	quint32 m_bgColor:4;
+	quint32 m_attributes:8;
+};
+
+}
+}
+
+// cells are relocatable by memcpy, QVector<ScreenCell> does not need to call copy constructors when growing
+Q_DECLARE_TYPEINFO(core::term::ScreenCell, Q_MOVABLE_TYPE);
+
+#endif // SCREENCELL_H
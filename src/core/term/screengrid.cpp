@@ -0,0 +1,206 @@
+#include "screengrid.h"
+
+#include <string.h>
+
+using namespace core::term;
+
+ScreenGrid::ScreenGrid()
+: m_columnCount(0), m_rowCount(0), m_firstRow(0), m_scrolledLines(0)
+{
+}
+
+void ScreenGrid::resize(int cols, int rows)
+{
+	if(cols < 0) cols = 0;
+	if(rows < 0) rows = 0;
+	if(cols == m_columnCount && rows == m_rowCount)
+		return;
+	QVector<ScreenCell> cells(cols * rows);
+	int copy_cols = qMin(cols, m_columnCount);
+	int copy_rows = qMin(rows, m_rowCount);
+	for(int y=0; y<copy_rows; y++) {
+		const ScreenCell *src = row(y);
+		ScreenCell *dest = cells.data() + y * cols;
+		for(int x=0; x<copy_cols; x++)
+			dest[x] = src[x];
+	}
+	m_cells = cells;
+	m_rowIndex.resize(rows);
+	for(int y=0; y<rows; y++)
+		m_rowIndex[y] = y;
+	m_columnCount = cols;
+	m_rowCount = rows;
+	m_firstRow = 0;
+	m_dirty.resize(rows);
+	setRowsDirty(0, rows - 1);
+}
+
+void ScreenGrid::swapCells(ScreenGrid &other)
+{
+	Q_ASSERT(m_columnCount == other.m_columnCount && m_rowCount == other.m_rowCount);
+	// implicitly shared vectors, only data pointers are exchanged
+	qSwap(m_cells, other.m_cells);
+	qSwap(m_rowIndex, other.m_rowIndex);
+	qSwap(m_firstRow, other.m_firstRow);
+	setRowsDirty(0, m_rowCount - 1);
+	other.setRowsDirty(0, other.m_rowCount - 1);
+}
+
+void ScreenGrid::fill(int y, int from_x, int to_x, const ScreenCell &c)
+{
+	if(from_x < 0) from_x = 0;
+	if(to_x > m_columnCount) to_x = m_columnCount;
+	if(from_x >= to_x)
+		return;
+	ScreenCell *cells = row(y);
+	for(int x=from_x; x<to_x; x++)
+		cells[x] = c;
+	setDirty(y, from_x, to_x);
+}
+
+void ScreenGrid::insertCells(int y, int x, int n, const ScreenCell &c)
+{
+	if(x < 0 || x >= m_columnCount || n <= 0)
+		return;
+	if(n > m_columnCount - x)
+		n = m_columnCount - x;
+	ScreenCell *cells = row(y);
+	// cells are movable type, see Q_DECLARE_TYPEINFO(ScreenCell)
+	::memmove(cells + x + n, cells + x, (m_columnCount - x - n) * sizeof(ScreenCell));
+	fill(y, x, x + n, c);
+	setDirty(y, x, m_columnCount);
+}
+
+void ScreenGrid::deleteCells(int y, int x, int n, const ScreenCell &c)
+{
+	if(x < 0 || x >= m_columnCount || n <= 0)
+		return;
+	if(n > m_columnCount - x)
+		n = m_columnCount - x;
+	ScreenCell *cells = row(y);
+	::memmove(cells + x, cells + x + n, (m_columnCount - x - n) * sizeof(ScreenCell));
+	fill(y, m_columnCount - n, m_columnCount, c);
+	setDirty(y, x, m_columnCount);
+}
+
+void ScreenGrid::setRowsDirty(int top, int bottom)
+{
+	for(int y=top; y<=bottom; y++) {
+		m_dirty[y].from = 0;
+		m_dirty[y].to = m_columnCount;
+	}
+}
+
+void ScreenGrid::clearDirty()
+{
+	m_scrolledLines = 0;
+	DirtySpan *d = m_dirty.data();
+	for(int y=0; y<m_rowCount; y++)
+		d[y].from = d[y].to = 0;
+}
+
+bool ScreenGrid::isRowBlank(int y) const
+{
+	const ScreenCell *cells = row(y);
+	for(int x=0; x<m_columnCount; x++) {
+		if(!cells[x].isNull())
+			return false;
+	}
+	return true;
+}
+
+void ScreenGrid::rotateSlots(int top, int bottom, int n)
+{
+	int h = bottom - top + 1;
+	n %= h;
+	if(n < 0)
+		n += h;
+	if(n == 0)
+		return;
+	// rotation by three reversals, no scratch array for tall regions
+	reverseSlots(top, top + n - 1);
+	reverseSlots(top + n, bottom);
+	reverseSlots(top, bottom);
+}
+
+void ScreenGrid::reverseSlots(int top, int bottom)
+{
+	for(; top < bottom; top++, bottom--)
+		qSwap(m_rowIndex[slot(top)], m_rowIndex[slot(bottom)]);
+}
+
+void ScreenGrid::scrollUp(int top, int bottom, int n)
+{
+	if(top < 0) top = 0;
+	if(bottom >= m_rowCount) bottom = m_rowCount - 1;
+	if(n <= 0 || top > bottom)
+		return;
+	int h = bottom - top + 1;
+	if(n > h)
+		n = h;
+	if(top == 0 && bottom == m_rowCount - 1)
+		m_firstRow = slot(n);
+	else
+		rotateSlots(top, bottom, n);
+	for(int y=bottom-n+1; y<=bottom; y++)
+		clearRow(y);
+	setRowsDirty(top, bottom);
+}
+
+void ScreenGrid::scrollScreenUp(int n)
+{
+	if(n <= 0 || m_rowCount == 0)
+		return;
+	if(n > m_rowCount)
+		n = m_rowCount;
+	m_firstRow = slot(n);
+	// view moves already painted rows itself, so dirty spans move with rows
+	DirtySpan *d = m_dirty.data();
+	for(int y=0; y<m_rowCount-n; y++)
+		d[y] = d[y + n];
+	for(int y=m_rowCount-n; y<m_rowCount; y++)
+		d[y].from = d[y].to = 0;
+	m_scrolledLines += n;
+	for(int y=m_rowCount-n; y<m_rowCount; y++)
+		clearRow(y);
+	// only newly exposed rows must be painted
+	setRowsDirty(m_rowCount - n, m_rowCount - 1);
+}
+
+void ScreenGrid::scrollScreenDown(int n)
+{
+	if(n <= 0 || m_rowCount == 0)
+		return;
+	if(n > m_rowCount)
+		n = m_rowCount;
+	m_firstRow = slot(m_rowCount - n);
+	// view moves already painted rows itself, so dirty spans move with rows
+	DirtySpan *d = m_dirty.data();
+	for(int y=m_rowCount-1; y>=n; y--)
+		d[y] = d[y - n];
+	for(int y=0; y<n; y++)
+		d[y].from = d[y].to = 0;
+	m_scrolledLines -= n;
+	for(int y=0; y<n; y++)
+		clearRow(y);
+	// only newly exposed rows must be painted
+	setRowsDirty(0, n - 1);
+}
+
+void ScreenGrid::scrollDown(int top, int bottom, int n)
+{
+	if(top < 0) top = 0;
+	if(bottom >= m_rowCount) bottom = m_rowCount - 1;
+	if(n <= 0 || top > bottom)
+		return;
+	int h = bottom - top + 1;
+	if(n > h)
+		n = h;
+	if(top == 0 && bottom == m_rowCount - 1)
+		m_firstRow = slot(m_rowCount - n);
+	else
+		rotateSlots(top, bottom, -n);
+	for(int y=top; y<top+n; y++)
+		clearRow(y);
+	setRowsDirty(top, bottom);
+}
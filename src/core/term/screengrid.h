@@ -0,0 +1,112 @@
+#ifndef SCREENGRID_H
+#define SCREENGRID_H
+
+#include "screencell.h"
+
+#include <QVector>
+
+namespace core {
+namespace term {
+
+// Visible screen cells stored in one contiguous width-strided array.
+// Logical rows are mapped to physical rows through a row index, so scrolling
+// moves row indices only, cells are never copied. Whole screen scroll advances
+// the first row and does not touch the index, scroll of a region rotates indices
+// of its rows, that is O(region height) int moves. Uncovered rows are cleared
+// and rows are marked dirty in both cases.
+class ScreenGrid
+{
+public:
+	ScreenGrid();
+public:
+	int columnCount() const {return m_columnCount;}
+	int rowCount() const {return m_rowCount;}
+	bool isEmpty() const {return m_columnCount == 0 || m_rowCount == 0;}
+	/// content of rows and columns existing in both old and new size is preserved
+	void resize(int cols, int rows);
+	/// exchange cells with grid of the same size without copying or allocation,
+	/// dirty spans stay with the grid, all its rows are marked dirty
+	void swapCells(ScreenGrid &other);
+
+	ScreenCell* row(int y) {return m_cells.data() + m_rowIndex[slot(y)] * m_columnCount;}
+	const ScreenCell* row(int y) const {return m_cells.constData() + m_rowIndex[slot(y)] * m_columnCount;}
+	ScreenCell& cell(int x, int y) {return row(y)[x];}
+	const ScreenCell& cell(int x, int y) const {return row(y)[x];}
+
+	/// fill cells <from_x, to_x) of row y
+	void fill(int y, int from_x, int to_x, const ScreenCell &c = ScreenCell());
+	void clearRow(int y, const ScreenCell &c = ScreenCell()) {fill(y, 0, m_columnCount, c);}
+	bool isRowBlank(int y) const;
+	/// shift cells of row y from column x right by n, cells shifted out of the row are lost
+	void insertCells(int y, int x, int n, const ScreenCell &c = ScreenCell());
+	/// remove n cells of row y at column x, the rest of the row shifts left
+	void deleteCells(int y, int x, int n, const ScreenCell &c = ScreenCell());
+
+	/// move rows <top, bottom> up by n, rows uncovered at bottom are cleared, all moved rows are dirty
+	void scrollUp(int top, int bottom, int n);
+	/// move whole screen up by n after caller moved top rows to history,
+	/// view blits already painted rows, so only uncovered rows are dirty and scrolledLines() grows
+	void scrollScreenUp(int n);
+	/// move rows <top, bottom> down by n, rows uncovered at top are cleared
+	void scrollDown(int top, int bottom, int n);
+	/// move whole screen down by n, view blits already painted rows,
+	/// so only uncovered rows are dirty and scrolledLines() decreases
+	void scrollScreenDown(int n);
+
+	// Changed cells are tracked as one span of columns per row.
+	// fill() and scroll functions mark rows dirty themselves,
+	// cells written through row() or cell() must be marked by the caller.
+	struct DirtySpan
+	{
+		qint16 from;
+		qint16 to;
+		bool isEmpty() const {return from >= to;}
+	};
+	/// mark cells <from_x, to_x) of row y as changed
+	void setDirty(int y, int from_x, int to_x)
+	{
+		DirtySpan &d = m_dirty[y];
+		if(d.isEmpty()) {
+			d.from = from_x;
+			d.to = to_x;
+		}
+		else {
+			if(from_x < d.from) d.from = from_x;
+			if(to_x > d.to) d.to = to_x;
+		}
+	}
+	void setRowsDirty(int top, int bottom);
+	const DirtySpan& dirtySpan(int y) const {return m_dirty[y];}
+	/// lines the whole screen was scrolled up by scrollScreenUp() since clearDirty(),
+	/// less scrollScreenDown(), dirty spans are relative to the scrolled screen
+	int scrolledLines() const {return m_scrolledLines;}
+	void clearDirty();
+private:
+	int slot(int y) const
+	{
+		int s = m_firstRow + y;
+		if(s >= m_rowCount)
+			s -= m_rowCount;
+		return s;
+	}
+	/// rotate row indices of region <top, bottom> up by n in place, O(bottom - top)
+	void rotateSlots(int top, int bottom, int n);
+	void reverseSlots(int top, int bottom);
+private:
+	QVector<ScreenCell> m_cells;
+	// physical row for every slot, logical row y is stored in slot (m_firstRow + y) % m_rowCount
+	QVector<int> m_rowIndex;
+	// dirty span for logical row
+	QVector<DirtySpan> m_dirty;
+	int m_columnCount;
+	int m_rowCount;
+	int m_firstRow;
+	int m_scrolledLines;
+};
+
+}
+}
+
+Q_DECLARE_TYPEINFO(core::term::ScreenGrid::DirtySpan, Q_PRIMITIVE_TYPE);
+
+#endif // SCREENGRID_H
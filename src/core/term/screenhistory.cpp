@@ -0,0 +1,248 @@
+#include "screenhistory.h"
+#include "historyblockstore.h"
+#include "mappedhistoryblockstore.h"
+
+//#define NO_BBTERM_LOG_DEBUG
+#include <core/util/log.h>
+
+using namespace core::term;
+
+//#define LOG_COLD_HISTORY
+
+namespace {
+
+// Cold block format, lines are stored one after another:
+//   varint cell_count
+//   cell_count letters as UTF-8, null cell is stored as 0 byte
+//   runs covering all cells: varint run_length, byte fg | bg << 4, byte attributes
+
+void appendVarint(QByteArray &ba, quint32 n)
+{
+	while(n >= 0x80) {
+		ba.append(static_cast<char>((n & 0x7f) | 0x80));
+		n >>= 7;
+	}
+	ba.append(static_cast<char>(n));
+}
+
+quint32 readVarint(const uchar *data, int *pos)
+{
+	quint32 ret = 0;
+	int shift = 0;
+	uchar b;
+	do {
+		b = data[(*pos)++];
+		ret |= static_cast<quint32>(b & 0x7f) << shift;
+		shift += 7;
+	} while(b & 0x80);
+	return ret;
+}
+
+void appendUtf8(QByteArray &ba, ushort u)
+{
+	if(u < 0x80) {
+		ba.append(static_cast<char>(u));
+	}
+	else if(u < 0x800) {
+		ba.append(static_cast<char>(0xc0 | (u >> 6)));
+		ba.append(static_cast<char>(0x80 | (u & 0x3f)));
+	}
+	else {
+		ba.append(static_cast<char>(0xe0 | (u >> 12)));
+		ba.append(static_cast<char>(0x80 | ((u >> 6) & 0x3f)));
+		ba.append(static_cast<char>(0x80 | (u & 0x3f)));
+	}
+}
+
+// block content is written by appendUtf8() only, so it needs no validation
+ushort readUtf8(const uchar *data, int *pos)
+{
+	uchar b = data[(*pos)++];
+	if(b < 0x80)
+		return b;
+	if(b < 0xe0) {
+		ushort u = (b & 0x1f) << 6;
+		return u | (data[(*pos)++] & 0x3f);
+	}
+	ushort u = (b & 0x0f) << 12;
+	u |= (data[(*pos)++] & 0x3f) << 6;
+	return u | (data[(*pos)++] & 0x3f);
+}
+
+}
+
+ScreenHistory::ScreenHistory(int depth, const QString &file_path, int hot_depth)
+: m_depth(depth), m_hotLines(qMin(depth, hot_depth)), m_blocks(0), m_firstBlockSerial(0), m_openBlockLineCount(0), m_cacheClock(0)
+{
+	if(!file_path.isEmpty()) {
+		MappedHistoryBlockStore *store = new MappedHistoryBlockStore();
+		if(store->open(file_path)) {
+			m_blocks = store;
+			m_depth = 0x7fffffff;
+			// line index must fit to int
+			m_maxBlockCount = (0x7fffffff - m_hotLines.capacity()) / LinesPerBlock - 1;
+		}
+		else {
+			LOGWARN() << "scrollback file cannot be used, keeping history in memory";
+			delete store;
+		}
+	}
+	if(!m_blocks) {
+		m_blocks = new MemoryHistoryBlockStore();
+		int cold_depth = depth - m_hotLines.capacity();
+		m_maxBlockCount = (cold_depth > 0)? (cold_depth + LinesPerBlock - 1) / LinesPerBlock: 0;
+	}
+	LOGDEB() << "scrollback depth:" << m_depth << "hot lines:" << m_hotLines.capacity() << "cold blocks:" << m_maxBlockCount;
+}
+
+ScreenHistory::~ScreenHistory()
+{
+	delete m_blocks;
+}
+
+int ScreenHistory::coldCount() const
+{
+	return m_blocks->count() * LinesPerBlock + m_openBlockLineCount;
+}
+
+void ScreenHistory::append(const ScreenCell *cells, int length)
+{
+	if(m_hotLines.isFull() && m_maxBlockCount > 0) {
+		// the oldest hot line is going to be evicted
+		packLine(m_hotLines.at(0));
+	}
+	// evicted hot line storage is refilled in place
+	m_hotLines.appendSlot().assign(cells, length);
+}
+
+bool ScreenHistory::removeLast()
+{
+	if(m_hotLines.count() == 0)
+		return false;
+	m_hotLines.removeLast();
+	return true;
+}
+
+ScreenLineView ScreenHistory::lineView(int ix) const
+{
+	if(ix < 0 || ix >= count())
+		return ScreenLineView();
+	// skip the oldest lines above depth
+	ix += storedCount() - count();
+	int cold_count = coldCount();
+	if(ix < cold_count) {
+		const UnpackedBlock &block = unpackedBlock(m_firstBlockSerial + ix / LinesPerBlock);
+		const ScreenLine &line = block.lines.at(ix % LinesPerBlock);
+		return ScreenLineView(line.constData(), line.size());
+	}
+	const ScreenLine &line = m_hotLines.at(ix - cold_count);
+	return ScreenLineView(line.constData(), line.size());
+}
+
+qint64 ScreenHistory::coldBytes() const
+{
+	return m_blocks->byteCount() + m_openBlock.size();
+}
+
+void ScreenHistory::packLine(const ScreenLine &line)
+{
+	const ScreenCell *cells = line.constData();
+	int length = line.size();
+	appendVarint(m_openBlock, length);
+	for(int i=0; i<length; i++)
+		appendUtf8(m_openBlock, cells[i].letter().unicode());
+	for(int i=0; i<length; ) {
+		int n = 1;
+		while(i + n < length && cells[i + n].isAllAttributesEqual(cells[i]))
+			n++;
+		appendVarint(m_openBlock, n);
+		m_openBlock.append(static_cast<char>(cells[i].fgColor() | (cells[i].bgColor() << 4)));
+		m_openBlock.append(static_cast<char>(cells[i].attributes()));
+		i += n;
+	}
+	// unpacked copy of open block is out of date now
+	invalidateUnpackedBlock(m_firstBlockSerial + m_blocks->count());
+	if(++m_openBlockLineCount == LinesPerBlock)
+		sealOpenBlock();
+}
+
+void ScreenHistory::sealOpenBlock()
+{
+	if(!m_blocks->append(m_openBlock)) {
+		LOGWARN() << LinesPerBlock << "lines of history lost";
+		// next block gets serial of the lost one
+		invalidateUnpackedBlock(m_firstBlockSerial + m_blocks->count());
+	}
+	m_openBlock = QByteArray();
+	m_openBlockLineCount = 0;
+	if(m_blocks->count() > m_maxBlockCount) {
+		m_blocks->removeFirst();
+		m_firstBlockSerial++;
+	}
+#ifdef LOG_COLD_HISTORY
+	LOGDEB() << "cold lines:" << coldCount() << "bytes:" << coldBytes() << "per line:" << (coldBytes() / qMax(coldCount(), 1));
+#endif
+}
+
+void ScreenHistory::invalidateUnpackedBlock(qint64 serial)
+{
+	for(int i=0; i<CachedBlockCount; i++) {
+		if(m_cache[i].serial == serial)
+			m_cache[i].serial = -1;
+	}
+}
+
+const ScreenHistory::UnpackedBlock& ScreenHistory::unpackedBlock(qint64 serial) const
+{
+	m_cacheClock++;
+	UnpackedBlock *lru = &m_cache[0];
+	for(int i=0; i<CachedBlockCount; i++) {
+		UnpackedBlock &b = m_cache[i];
+		if(b.serial == serial) {
+			b.lastUse = m_cacheClock;
+			return b;
+		}
+		if(b.lastUse < lru->lastUse)
+			lru = &b;
+	}
+	int block_ix = static_cast<int>(serial - m_firstBlockSerial);
+	if(block_ix < m_blocks->count())
+		unpackBlock(m_blocks->block(block_ix), lru->lines);
+	else
+		unpackBlock(m_openBlock, lru->lines);
+	lru->serial = serial;
+	lru->lastUse = m_cacheClock;
+	return *lru;
+}
+
+void ScreenHistory::unpackBlock(const QByteArray &block, QVector<ScreenLine> &lines)
+{
+	const uchar *data = reinterpret_cast<const uchar*>(block.constData());
+	int size = block.size();
+	int pos = 0;
+	int line_count = 0;
+	while(pos < size) {
+		if(line_count == lines.size())
+			lines.append(ScreenLine());
+		ScreenLine &line = lines[line_count++];
+		int length = readVarint(data, &pos);
+		// line storage of previously unpacked block is reused
+		if(line.capacity() < length)
+			line.reserve(length);
+		line.resize(length);
+		ScreenCell *cells = line.data();
+		for(int i=0; i<length; i++)
+			cells[i].setLetter(QChar(readUtf8(data, &pos)));
+		for(int i=0; i<length; ) {
+			int n = readVarint(data, &pos);
+			ScreenCell::Color colors = data[pos++];
+			ScreenCell::Attributes attributes = data[pos++];
+			for(int j=0; j<n; j++) {
+				cells[i + j].setColor(colors & 0x0f, colors >> 4);
+				cells[i + j].setAttributes(attributes);
+			}
+			i += n;
+		}
+	}
+	lines.resize(line_count);
+}
@@ -0,0 +1,80 @@
+#ifndef SCREENHISTORY_H
+#define SCREENHISTORY_H
+
+#include "screenline.h"
+
+#include <core/util/ringbuffer.h>
+
+#include <QByteArray>
+#include <QString>
+
+namespace core {
+namespace term {
+
+class HistoryBlockStore;
+
+// Scrollback history in two tiers.
+// Recent (hot) lines are kept as cells in a ring. Lines evicted from the hot ring
+// are packed to cold blocks of LinesPerBlock lines, text as UTF-8 plus runs of attributes.
+// Cold blocks are unpacked on demand, the last few unpacked blocks are cached.
+// Cold blocks are kept on the heap or, if file_path is set, in unbounded memory mapped log.
+class ScreenHistory
+{
+	Q_DISABLE_COPY(ScreenHistory)
+public:
+	static const int DefaultHotDepth = 1024;
+	static const int LinesPerBlock = 256;
+	static const int CachedBlockCount = 4;
+public:
+	/// depth is number of lines in both tiers, cold tier is used only if depth > hot_depth,
+	/// depth is ignored when cold blocks are stored in file_path
+	explicit ScreenHistory(int depth, const QString &file_path = QString(), int hot_depth = DefaultHotDepth);
+	~ScreenHistory();
+
+	/// never more than depth lines, tiers may hold a few more because of rounding
+	int count() const {return qMin(storedCount(), m_depth);}
+	int hotCount() const {return m_hotLines.count();}
+	void append(const ScreenCell *cells, int length);
+	/// removes the newest line, returns false if it is not in the hot tier
+	bool removeLast();
+	/// view of a cold line is valid until CachedBlockCount other blocks are unpacked
+	ScreenLineView lineView(int ix) const;
+	/// bytes occupied by packed cold blocks
+	qint64 coldBytes() const;
+private:
+	struct UnpackedBlock
+	{
+		qint64 serial;
+		int lastUse;
+		QVector<ScreenLine> lines;
+		UnpackedBlock() : serial(-1), lastUse(0) {}
+	};
+private:
+	int storedCount() const {return coldCount() + m_hotLines.count();}
+	int coldCount() const;
+	void packLine(const ScreenLine &line);
+	void sealOpenBlock();
+	void invalidateUnpackedBlock(qint64 serial);
+	const UnpackedBlock& unpackedBlock(qint64 serial) const;
+	static void unpackBlock(const QByteArray &block, QVector<ScreenLine> &lines);
+private:
+	// hot ring is rounded up to power of 2 and cold tier to whole blocks,
+	// lines stored above depth are hidden as if they were trimmed
+	int m_depth;
+	core::util::RingBuffer<ScreenLine> m_hotLines;
+	// sealed cold blocks, the oldest first, block i has serial m_firstBlockSerial + i
+	HistoryBlockStore *m_blocks;
+	int m_maxBlockCount;
+	qint64 m_firstBlockSerial;
+	// block being filled, its serial is m_firstBlockSerial + m_blocks->count()
+	QByteArray m_openBlock;
+	int m_openBlockLineCount;
+
+	mutable UnpackedBlock m_cache[CachedBlockCount];
+	mutable int m_cacheClock;
+};
+
+}
+}
+
+#endif // SCREENHISTORY_H
@@ -0,0 +1,86 @@
+#ifndef SCREENLINE_H
+#define SCREENLINE_H
+
+#include "screencell.h"
+
+#include <QVector>
+#include <QString>
+
+namespace core {
+namespace term {
+
+// line of scrollback history
+class ScreenLine : public QVector<ScreenCell>
+{
+public:
+	ScreenLine() {}
+	/// trailing null cells are not stored
+	ScreenLine(const ScreenCell *cells, int length) {assign(cells, length);}
+	/// replace content, allocated storage is reused when it is big enough
+	void assign(const ScreenCell *cells, int length)
+	{
+		while(length > 0 && cells[length - 1].isNull())
+			length--;
+		// reserve marks capacity as explicit, so resize() never shrinks the buffer
+		if(capacity() < length)
+			reserve(length);
+		resize(length);
+		ScreenCell *dest = data();
+		for(int i=0; i<length; i++)
+			dest[i] = cells[i];
+	}
+};
+
+// Read only view of cells of one line, nothing is copied.
+// View is valid until the screen buffer is modified.
+class ScreenLineView
+{
+public:
+	ScreenLineView(const ScreenCell *cells = 0, int length = 0)
+	: m_cells(cells), m_length(length) {}
+
+	const ScreenCell* cells() const {return m_cells;}
+	int length() const {return m_length;}
+	bool isEmpty() const {return m_length == 0;}
+	const ScreenCell& at(int ix) const {return m_cells[ix];}
+	/// returns cell at ix or default cell if ix is out of line
+	ScreenCell value(int ix) const
+	{
+		if(ix >= 0 && ix < m_length)
+			return m_cells[ix];
+		return ScreenCell();
+	}
+	/// returns length of run of cells with the same colors and attributes starting at ix
+	int runLength(int ix) const
+	{
+		int end = ix + 1;
+		while(end < m_length && m_cells[end].isAllAttributesEqual(m_cells[ix]))
+			end++;
+		return end - ix;
+	}
+	/// copy letters of cells <ix, ix + n) to buffer, null cells are written as spaces
+	void copyLetters(int ix, int n, QChar *buffer) const
+	{
+		const ScreenCell *c = m_cells + ix;
+		for(int i=0; i<n; i++) {
+			QChar ch = c[i].letter();
+			buffer[i] = ch.isNull()? QChar(' '): ch;
+		}
+	}
+	QString toString() const
+	{
+		QString ret(m_length, QChar(' '));
+		copyLetters(0, m_length, ret.data());
+		return ret;
+	}
+private:
+	const ScreenCell *m_cells;
+	int m_length;
+};
+
+}
+}
+
+Q_DECLARE_TYPEINFO(core::term::ScreenLine, Q_MOVABLE_TYPE);
+
+#endif // SCREENLINE_H
@@ -0,0 +1,61 @@
+#include "screensnapshot.h"
+
+using namespace core::term;
+
+void ScreenDamage::add(const QRect &rect)
+{
+	if(isFull)
+		return;
+	for(int i=0; i<rects.count(); i++) {
+		if(rects[i].contains(rect))
+			return;
+	}
+	if(rects.count() < MaxRects) {
+		rects.append(rect);
+		return;
+	}
+	// too many rects, merge the new one with the nearest rect
+	int best_ix = 0;
+	int best_area = -1;
+	for(int i=0; i<rects.count(); i++) {
+		QRect u = rects[i].united(rect);
+		int area = u.width() * u.height();
+		if(best_area < 0 || area < best_area) {
+			best_area = area;
+			best_ix = i;
+		}
+	}
+	rects[best_ix] = rects[best_ix].united(rect);
+}
+
+void ScreenDamage::add(const ScreenDamage &other)
+{
+	if(other.isFull) {
+		isFull = true;
+		rects.clear();
+		return;
+	}
+	for(int i=0; i<other.rects.count(); i++)
+		add(other.rects[i]);
+}
+
+void ScreenSnapshot::clearLines()
+{
+	// reserve marks capacity as explicit, so resize() never shrinks the buffers
+	m_cells.reserve(m_cells.capacity());
+	m_rowStart.reserve(m_rowStart.capacity());
+	m_cells.resize(0);
+	m_rowStart.resize(1);
+	m_rowStart[0] = 0;
+}
+
+void ScreenSnapshot::appendLine(const ScreenLineView &line)
+{
+	int start = m_cells.size();
+	m_cells.resize(start + line.length());
+	ScreenCell *dest = m_cells.data() + start;
+	const ScreenCell *src = line.cells();
+	for(int i=0; i<line.length(); i++)
+		dest[i] = src[i];
+	m_rowStart.append(m_cells.size());
+}
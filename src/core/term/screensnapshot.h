@@ -0,0 +1,71 @@
+#ifndef SCREENSNAPSHOT_H
+#define SCREENSNAPSHOT_H
+
+#include "screencell.h"
+#include "screenline.h"
+
+#include <QVector>
+#include <QSize>
+#include <QPoint>
+#include <QRect>
+
+namespace core {
+namespace term {
+
+// Cells changed since the snapshot last taken by the view.
+// Rows are absolute line numbers (screen row + ScreenSnapshot::scrolledLines),
+// so damage of a skipped snapshot stays valid in a later one after the screen scrolled.
+class ScreenDamage
+{
+public:
+	static const int MaxRects = 8;
+public:
+	ScreenDamage() : isFull(false) {}
+
+	bool isEmpty() const {return !isFull && rects.isEmpty();}
+	void clear() {isFull = false; rects.clear();}
+	/// rects over MaxRects are merged to their bounding rect
+	void add(const QRect &rect);
+	void add(const ScreenDamage &other);
+public:
+	bool isFull;
+	QVector<QRect> rects;
+};
+
+// Copy of visible lines, cursor and damage of screen buffer.
+// Parser fills snapshots on its own thread, view paints the latest one without locking.
+class ScreenSnapshot
+{
+public:
+	ScreenSnapshot() : historyCount(0), historyOffset(0), scrolledLines(0) {}
+
+	/// visible rows, history is shown above the screen when historyOffset > 0
+	int rowCount() const {return m_rowStart.isEmpty()? 0: m_rowStart.count() - 1;}
+	ScreenLineView lineView(int y) const
+	{
+		if(y < 0 || y >= rowCount())
+			return ScreenLineView();
+		return ScreenLineView(m_cells.constData() + m_rowStart[y], m_rowStart[y + 1] - m_rowStart[y]);
+	}
+	/// allocated storage is reused
+	void clearLines();
+	void appendLine(const ScreenLineView &line);
+public:
+	QSize terminalSize;
+	// number of history lines above the screen, view cannot be scrolled back further
+	int historyCount;
+	// lines of history shown above the screen
+	int historyOffset;
+	QPoint cursorPosition;
+	// lines scrolled up (less lines scrolled down) since the screen buffer was created
+	qint64 scrolledLines;
+	ScreenDamage damage;
+private:
+	QVector<ScreenCell> m_cells;
+	QVector<int> m_rowStart;
+};
+
+}
+}
+
+#endif // SCREENSNAPSHOT_H
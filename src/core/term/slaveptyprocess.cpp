@@ -1,4 +1,5 @@
 #include "slaveptyprocess.h"
+#include "ptytrace.h"
 
 #include <core/util/log.h>
 
@@ -15,7 +16,7 @@
 using namespace core::term;
 
 SlavePtyProcess::SlavePtyProcess(int master_fd, pid_t pid, QObject *parent)
-: QIODevice(parent), m_masterFd(master_fd), m_pid(pid)
+: QIODevice(parent), m_masterFd(master_fd), m_pid(pid), m_readNotificationEnabled(true), m_pasteChunkLeft(0)
 {
 	{
 		struct ::termios ttmode;
@@ -40,8 +41,10 @@ SlavePtyProcess::SlavePtyProcess(int master_fd, pid_t pid, QObject *parent)
 	}
 	m_readNotifier = new QSocketNotifier(m_masterFd, QSocketNotifier::Read, this);
 	connect(m_readNotifier, SIGNAL(activated(int)), this, SIGNAL(readyRead()));
-	//m_writeNotifier = new QSocketNotifier(m_masterFd, QSocketNotifier::Write, this);
-	//connect(m_writeNotifier, SIGNAL(activated(int)), this, SIGNAL(readyRead());
+	// enabled only when something is queued
+	m_writeNotifier = new QSocketNotifier(m_masterFd, QSocketNotifier::Write, this);
+	m_writeNotifier->setEnabled(false);
+	connect(m_writeNotifier, SIGNAL(activated(int)), this, SLOT(flushWriteQueues()));
 }
 
 void SlavePtyProcess::setSize(int cols, int rows)
@@ -69,35 +72,129 @@ void SlavePtyProcess::setSize(int cols, int rows)
 	}
 }
 
-#define LOG_READ_WRITE
+void SlavePtyProcess::setReadNotificationEnabled(bool on)
+{
+	m_readNotificationEnabled = on;
+	m_readNotifier->setEnabled(on);
+}
+
 qint64 SlavePtyProcess::readData(char *data, qint64 max_size)
 {
 	//qDebug() << Q_FUNC_INFO;
 	m_readNotifier->setEnabled(false);
 	qint64 ret = ::read(m_masterFd, data, max_size);
 	if(ret > 0) {
-		QByteArray ba(data, ret);
-#ifdef LOG_READ_WRITE
-		qDebug() << __FUNCTION__ << ret << "bytes read" << ba << "HEX:" << ba.toHex();
-#endif
+		PtyTrace::record(PtyTraceRead, data, ret);
+	}
+	else if(ret == 0) {
+		// EOF
+		ret = -1;
 	}
-	m_readNotifier->setEnabled(true);
+	else if(errno == EAGAIN || errno == EINTR) {
+		// no data available now
+		ret = 0;
+	}
+	m_readNotifier->setEnabled(m_readNotificationEnabled);
 	return ret;
 }
 
 qint64 SlavePtyProcess::writeData(const char *data, qint64 max_size)
 {
 	//qDebug() << Q_FUNC_INFO;
-	qint64 ret = ::write(m_masterFd, data, max_size);
-	if(ret > 0) {
-		QByteArray ba(data, ret);
-#ifdef LOG_READ_WRITE
-		qDebug() << __FUNCTION__ << ret << "bytes written" << ba << "HEX:" << ba.toHex();
-#endif
+	m_interactiveQueue.append(QByteArray(data, max_size));
+	flushWriteQueues();
+	// everything is accepted, the rest is written later
+	return max_size;
+}
+
+void SlavePtyProcess::writeReply(const QByteArray &data)
+{
+	write(data);
+}
+
+bool SlavePtyProcess::paste(const QByteArray &data)
+{
+	if(m_pasteQueue.size + data.size() > MaxPasteQueueSize) {
+		LOGWARN() << "paste queue is full," << data.size() << "bytes dropped";
+		return false;
 	}
-	if(ret < 0) {
-		QString s = QString::fromUtf8(::strerror(errno));
-		qWarning() << "error write data to" << m_masterFd << ":" << s;
+	m_pasteQueue.append(data);
+	flushWriteQueues();
+	return true;
+}
+
+qint64 SlavePtyProcess::bytesToWrite() const
+{
+	return m_interactiveQueue.size + m_pasteQueue.size;
+}
+
+void SlavePtyProcess::flushWriteQueues()
+{
+	qint64 written = 0;
+	while(true) {
+		bool is_paste = (m_pasteChunkLeft > 0 || m_interactiveQueue.isEmpty());
+		WriteQueue &queue = is_paste? m_pasteQueue: m_interactiveQueue;
+		if(queue.isEmpty())
+			break;
+		const QByteArray &head = queue.chunks.first();
+		const char *data = head.constData() + queue.headOffset;
+		int n = head.size() - queue.headOffset;
+		if(is_paste) {
+			if(m_pasteChunkLeft == 0) {
+				m_pasteChunkLeft = qMin(n, static_cast<int>(PasteChunkSize));
+				// interactive input can get in between chunks, so chunk must not split UTF-8 sequence
+				while(m_pasteChunkLeft < n && m_pasteChunkLeft > 1 && (data[m_pasteChunkLeft] & 0xc0) == 0x80)
+					m_pasteChunkLeft--;
+			}
+			n = m_pasteChunkLeft;
+		}
+		ssize_t ret = ::write(m_masterFd, data, n);
+		if(ret < 0) {
+			if(errno == EINTR)
+				continue;
+			if(errno == EAGAIN)
+				break;
+			QString s = QString::fromUtf8(::strerror(errno));
+			qWarning() << "error write data to" << m_masterFd << ":" << s;
+			// nobody is going to read queued data
+			m_interactiveQueue.clear();
+			m_pasteQueue.clear();
+			m_pasteChunkLeft = 0;
+			break;
+		}
+		PtyTrace::record(PtyTraceWrite, data, ret);
+		if(is_paste)
+			m_pasteChunkLeft -= ret;
+		queue.consume(ret);
+		written += ret;
 	}
-	return ret;
+	// PTY is full, continue when it accepts more
+	m_writeNotifier->setEnabled(bytesToWrite() > 0);
+	if(written > 0)
+		emit bytesWritten(written);
+}
+
+void SlavePtyProcess::WriteQueue::append(const QByteArray &data)
+{
+	if(data.isEmpty())
+		return;
+	chunks.append(data);
+	size += data.size();
+}
+
+void SlavePtyProcess::WriteQueue::consume(int n)
+{
+	headOffset += n;
+	size -= n;
+	if(headOffset == chunks.first().size()) {
+		chunks.removeFirst();
+		headOffset = 0;
+	}
+}
+
+void SlavePtyProcess::WriteQueue::clear()
+{
+	chunks.clear();
+	headOffset = 0;
+	size = 0;
 }
@@ -2,30 +2,71 @@
 #define SLAVEPTYPROCESS_H
 
 #include <QIODevice>
+#include <QList>
+#include <QByteArray>
 
 class QSocketNotifier;
 
 namespace core {
 namespace term {
 
+// Writes never block and never drop data, what the PTY does not accept now is queued
+// and written when the write notifier fires. Data written by write() are interactive input,
+// they go before pasted data which are written in chunks.
 class SlavePtyProcess : public QIODevice
 {
 	Q_OBJECT
+public:
+	static const int PasteChunkSize = 4 * 1024;
+	static const int MaxPasteQueueSize = 16 * 1024 * 1024;
 public:
 	explicit SlavePtyProcess(int master_fd, pid_t pid, QObject *parent = 0);
 public:
 	void setSize(int cols, int rows);
+	int masterFd() const {return m_masterFd;}
+	/// reader disables notifications while it has a backlog of unparsed input
+	void setReadNotificationEnabled(bool on);
+	/// queue data behind interactive input, returns false and drops data if paste queue is full
+	bool paste(const QByteArray &data);
+	/// bytes queued and not written to PTY yet, bytesWritten() is emitted as queue drains
+	virtual qint64 bytesToWrite() const;
 protected:
 	virtual qint64 readData(char* data, qint64 maxSize);
 	virtual qint64 writeData(const char* data, qint64 maxSize);
 signals:
 public slots:
 	//void sendCommand(const QString &cmd);
+	/// answer to terminal query, it goes with interactive input before pasted data,
+	/// slot can be invoked from parser thread
+	void writeReply(const QByteArray &data);
+private slots:
+	void flushWriteQueues();
+private:
+	class WriteQueue
+	{
+	public:
+		WriteQueue() : headOffset(0), size(0) {}
+		bool isEmpty() const {return size == 0;}
+		void append(const QByteArray &data);
+		/// n bytes from head were written
+		void consume(int n);
+		void clear();
+	public:
+		QList<QByteArray> chunks;
+		// written bytes of the first chunk
+		int headOffset;
+		qint64 size;
+	};
 private:
 	int m_masterFd;
 	pid_t m_pid;
 	QSocketNotifier *m_readNotifier;
-	//QSocketNotifier *m_writeNotifier;
+	bool m_readNotificationEnabled;
+	QSocketNotifier *m_writeNotifier;
+	WriteQueue m_interactiveQueue;
+	WriteQueue m_pasteQueue;
+	// rest of paste chunk being written, interactive input cannot get in until it is done
+	int m_pasteChunkLeft;
 };
 
 }
@@ -2,12 +2,33 @@ SOURCES += \
 	$$PWD/slaveptyprocess.cpp \
 	$$PWD/screenbuffer.cpp \
 	$$PWD/terminal.cpp \
-	$$PWD/screenbuffer_escape.cpp
+	$$PWD/terminalemulator.cpp \
+	$$PWD/screensnapshot.cpp \
+	$$PWD/ptyreader.cpp \
+	$$PWD/ptytrace.cpp \
+	$$PWD/screenbuffer_escape.cpp \
+	$$PWD/escapeparser.cpp \
+	$$PWD/screengrid.cpp \
+	$$PWD/screenhistory.cpp \
+	$$PWD/historyblockstore.cpp \
+	$$PWD/mappedhistoryblockstore.cpp
 
 HEADERS  += \
 	$$PWD/slaveptyprocess.h \
 	$$PWD/screenbuffer.h \
-	$$PWD/terminal.h
+	$$PWD/terminal.h \
+	$$PWD/terminalemulator.h \
+	$$PWD/screensnapshot.h \
+	$$PWD/ptyreader.h \
+	$$PWD/ptytrace.h \
+	$$PWD/ptytraceformat.h \
+	$$PWD/escapeparser.h \
+	$$PWD/screencell.h \
+	$$PWD/screengrid.h \
+	$$PWD/screenline.h \
+	$$PWD/screenhistory.h \
+	$$PWD/historyblockstore.h \
+	$$PWD/mappedhistoryblockstore.h
 
 FORMS += \
 
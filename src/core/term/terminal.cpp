@@ -1,21 +1,44 @@
 #include "terminal.h"
 
 #include "slaveptyprocess.h"
-#include "screenbuffer.h"
+#include "terminalemulator.h"
 
 //#define NO_BBTERM_LOG_DEBUG
 #include <core/util/log.h>
 
-#include <QApplication>
-#include <QDebug>
+#include <QThread>
 
 using namespace core::term;
 
 Terminal::Terminal(core::term::SlavePtyProcess *pty_process, QObject *parent) :
-	QObject(parent), m_slavePtyProcess(pty_process)
+	QObject(parent), m_slavePtyProcess(pty_process), m_parserThread(0)
 {
-	m_screenBuffer = new ScreenBuffer(m_slavePtyProcess, this);
-	connect(m_slavePtyProcess, SIGNAL(readyRead()), this, SLOT(onPtyProcessReadyRead()));
+	// no parent, object with parent cannot be moved to another thread
+	m_emulator = new TerminalEmulator(m_slavePtyProcess);
+	connect(m_emulator, SIGNAL(snapshotReady()), this, SIGNAL(snapshotReady()));
+	// parser thread needs PTY reader thread, socket notifier of PTY lives on GUI thread
+	// BBTERM_PARSER_THREAD=0 parses on GUI thread, for comparison
+	if(m_emulator->hasPtyReaderThread() && qgetenv("BBTERM_PARSER_THREAD") != "0") {
+		m_parserThread = new QThread(this);
+		m_emulator->moveToThread(m_parserThread);
+		// timers of emulator live on parser thread, it must be deleted there
+		connect(m_parserThread, SIGNAL(finished()), m_emulator, SLOT(deleteLater()));
+		m_parserThread->start();
+	}
+	LOGDEB() << "parser thread:" << (m_parserThread != 0);
+}
+
+Terminal::~Terminal()
+{
+	if(m_parserThread) {
+		// emulator is deleted by parser thread when its event loop finishes
+		m_parserThread->quit();
+		m_parserThread->wait();
+	}
+	else {
+		delete m_emulator;
+	}
+	m_emulator = 0;
 }
 
 SlavePtyProcess *Terminal::slavePtyProcess()
@@ -25,31 +48,24 @@ SlavePtyProcess *Terminal::slavePtyProcess()
 	return m_slavePtyProcess;
 }
 
-ScreenBuffer *Terminal::screenBuffer()
+void Terminal::setTerminalSize(const QSize &cols_rows)
 {
-	if(!m_screenBuffer)
-		qFatal("ScreenBuffer is NULL");
-	return m_screenBuffer;
+	m_terminalSize = cols_rows;
+	// queued when parser runs on its own thread
+	QMetaObject::invokeMethod(m_emulator, "setTerminalSize", Q_ARG(QSize, cols_rows));
 }
 
-void Terminal::onPtyProcessReadyRead()
+void Terminal::setViewOffset(int history_lines_offset)
 {
-	QByteArray ba = m_slavePtyProcess->readAll();
-	/*
-	LOGDEB() << "$$$$$$$$$$$$$$$$$$$$$$";
-	LOGDEB() << ba;
-	LOGDEB() << "==============================================================";
-	LOGDEB() << ba.toHex();
-	LOGDEB() << "$$$$$$$$$$$$$$$$$$$$$$";
-	*/
-	if(ba.length() == 0) {
-		// slave process finished ???
-		qDebug() << "zero bytes read slave process finished ???";
-		qDebug() << "Quitting the application";
-		QApplication::quit();
-	}
-	else {
-		QString s = QString::fromUtf8(ba);
-		m_screenBuffer->processInput(s);
-	}
+	QMetaObject::invokeMethod(m_emulator, "setViewOffset", Q_ARG(int, history_lines_offset));
+}
+
+bool Terminal::updateSnapshot()
+{
+	return m_emulator->snapshots().update();
+}
+
+const ScreenSnapshot &Terminal::snapshot() const
+{
+	return m_emulator->snapshots().front();
 }
@@ -2,26 +2,47 @@
 #define TERMINAL_H
 
 #include <QObject>
+#include <QSize>
+
+class QThread;
 
 namespace core {
 namespace term {
 
-class ScreenBuffer;
 class SlavePtyProcess;
+class TerminalEmulator;
+class ScreenSnapshot;
 
+// Terminal as seen from GUI thread.
+// Parsing runs in TerminalEmulator on a parser thread, view paints ScreenSnapshots it publishes.
 class Terminal : public QObject
 {
 	Q_OBJECT
 public:
 	explicit Terminal(core::term::SlavePtyProcess *pty_process, QObject *parent = 0);
+	virtual ~Terminal();
 public:
 	SlavePtyProcess* slavePtyProcess();
-	ScreenBuffer* screenBuffer();
-private slots:
-	void onPtyProcessReadyRead();
+
+	void setTerminalSize(const QSize &cols_rows);
+	/// the last requested size, parser may not have applied it yet
+	QSize terminalSize() const {return m_terminalSize;}
+	/// lines of history shown above the screen, snapshot with new offset follows
+	void setViewOffset(int history_lines_offset);
+
+	/// take the latest snapshot, returns false if nothing new was published since the last call
+	bool updateSnapshot();
+	/// snapshot taken by the last updateSnapshot(), valid until the next call
+	const ScreenSnapshot& snapshot() const;
+signals:
+	/// emitted on GUI thread when a new snapshot can be taken
+	void snapshotReady();
 private:
 	SlavePtyProcess *m_slavePtyProcess;
-	ScreenBuffer *m_screenBuffer;
+	TerminalEmulator *m_emulator;
+	// 0 if parser runs on GUI thread
+	QThread *m_parserThread;
+	QSize m_terminalSize;
 };
 
 }
@@ -0,0 +1,216 @@
+#include "terminalemulator.h"
+
+#include "slaveptyprocess.h"
+#include "screenbuffer.h"
+#include "ptyreader.h"
+
+//#define NO_BBTERM_LOG_DEBUG
+#include <core/util/log.h>
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QDebug>
+
+//#define LOG_THROUGHPUT
+
+using namespace core::term;
+
+TerminalEmulator::TerminalEmulator(SlavePtyProcess *pty_process, QObject *parent)
+: QObject(parent), m_slavePtyProcess(pty_process), m_ptyReader(0), m_input(0), m_inputReadPos(0), m_inputWritePos(0)
+, m_scrolledLines(0), m_viewOffset(0), m_snapshotDeferred(false)
+{
+	m_screenBuffer = new ScreenBuffer(m_slavePtyProcess, this);
+	connect(m_screenBuffer, SIGNAL(dirtyRegion(QRect)), this, SLOT(onDirtyRegion(QRect)));
+	connect(m_screenBuffer, SIGNAL(scrolled(int)), this, SLOT(onScrolled(int)));
+	connect(m_screenBuffer, SIGNAL(synchronizedUpdateFinished()), this, SLOT(onSynchronizedUpdateFinished()));
+	m_continueTimer = new QTimer(this);
+	m_continueTimer->setSingleShot(true);
+	m_continueTimer->setInterval(0);
+	connect(m_continueTimer, SIGNAL(timeout()), this, SLOT(processInputSlice()));
+	// BBTERM_PTY_THREAD=0 reads PTY on GUI thread, for comparison
+	if(qgetenv("BBTERM_PTY_THREAD") != "0") {
+		m_slavePtyProcess->setReadNotificationEnabled(false);
+		m_ptyReader = new PtyReader(m_slavePtyProcess->masterFd(), this);
+		connect(m_ptyReader, SIGNAL(readyRead()), this, SLOT(onPtyProcessReadyRead()));
+		m_ptyReader->start();
+	}
+	else {
+		m_inputBuffer.resize(InputBufferSize);
+		connect(m_slavePtyProcess, SIGNAL(readyRead()), this, SLOT(onPtyProcessReadyRead()));
+	}
+}
+
+TerminalEmulator::~TerminalEmulator()
+{
+	if(m_ptyReader)
+		m_ptyReader->stop();
+}
+
+bool TerminalEmulator::hasPtyReaderThread() const
+{
+	return m_ptyReader != 0;
+}
+
+void TerminalEmulator::setTerminalSize(const QSize &cols_rows)
+{
+	if(cols_rows == m_screenBuffer->terminalSize())
+		return;
+	m_screenBuffer->setTerminalSize(cols_rows);
+	m_damage.isFull = true;
+	publishSnapshot();
+}
+
+void TerminalEmulator::setViewOffset(int history_lines_offset)
+{
+	m_viewOffset = history_lines_offset;
+	publishSnapshot();
+}
+
+void TerminalEmulator::onDirtyRegion(const QRect &rect)
+{
+	if(rect.isNull())
+		m_damage.isFull = true;
+	else
+		m_damage.add(rect.translated(0, static_cast<int>(m_scrolledLines)));
+}
+
+void TerminalEmulator::onScrolled(int lines)
+{
+	m_scrolledLines += lines;
+	// alternate screen scrolls up and any screen scrolls down without history change,
+	// history shown above the screen does not move then, so it must not be blitted
+	if(m_viewOffset > 0 && (lines < 0 || m_screenBuffer->isAlternateScreenActive()))
+		m_damage.isFull = true;
+}
+
+void TerminalEmulator::onSynchronizedUpdateFinished()
+{
+	// emitted in the middle of input slice or by timeout when no input is parsed,
+	// either way the frame must be published before the next update changes the screen
+	if(m_snapshotDeferred || !m_damage.isEmpty())
+		publishSnapshot();
+}
+
+void TerminalEmulator::publishSnapshot()
+{
+	// view would show half drawn frame, onSynchronizedUpdateFinished() publishes it
+	if(m_screenBuffer->isSynchronizedUpdateActive()) {
+		m_snapshotDeferred = true;
+		return;
+	}
+	m_snapshotDeferred = false;
+	ScreenSnapshot &snapshot = m_snapshots.back();
+	// damage of the previous snapshot is repeated until view takes one,
+	// rows are absolute, so repeated damage is painted at the right place even after scroll
+	if(m_snapshots.isConsumed())
+		m_publishedDamage.clear();
+	m_publishedDamage.add(m_damage);
+	m_damage.clear();
+	snapshot.damage = m_publishedDamage;
+
+	QSize size = m_screenBuffer->terminalSize();
+	int history_count = m_screenBuffer->firstVisibleLineIndex();
+	int offset = qBound(0, m_viewOffset, history_count);
+	snapshot.terminalSize = size;
+	snapshot.historyCount = history_count;
+	snapshot.historyOffset = offset;
+	snapshot.cursorPosition = m_screenBuffer->cursorPosition();
+	snapshot.scrolledLines = m_scrolledLines;
+	snapshot.clearLines();
+	for(int y=0; y<size.height(); y++)
+		snapshot.appendLine(m_screenBuffer->lineView(history_count - offset + y));
+	m_snapshots.publish();
+	emit snapshotReady();
+}
+
+void TerminalEmulator::onPtyProcessReadyRead()
+{
+	processInputSlice();
+}
+
+void TerminalEmulator::processInputSlice()
+{
+	QElapsedTimer tm;
+	tm.start();
+#ifdef LOG_THROUGHPUT
+	static qint64 bytes_processed = 0;
+	static qint64 nsecs_spent = 0;
+	static qint64 max_slice_nsecs = 0;
+#endif
+	while(true) {
+		if(m_inputReadPos == m_inputWritePos) {
+			int n = nextInput();
+			if(n < 0) {
+				// slave process finished ???
+				qDebug() << "end of input, slave process finished ???";
+				qDebug() << "Quitting the application";
+				// parser may run on its own thread
+				QMetaObject::invokeMethod(qApp, "quit", Qt::QueuedConnection);
+				return;
+			}
+			if(n == 0) {
+				// PTY is drained, wait for socket notifier or reader thread
+				if(!m_ptyReader)
+					m_slavePtyProcess->setReadNotificationEnabled(true);
+				break;
+			}
+		}
+		int n = qMin(ParseChunkSize, m_inputWritePos - m_inputReadPos);
+		// parser keeps its state, an incomplete sequence at the end of the chunk does not need to be retained
+		m_screenBuffer->processInput(m_input + m_inputReadPos, n);
+		m_inputReadPos += n;
+#ifdef LOG_THROUGHPUT
+		bytes_processed += n;
+#endif
+		if(tm.elapsed() >= SliceBudgetMs) {
+			// yield to event loop, pending key presses and paints are handled before the next slice,
+			// socket notifier would only fire again for data which are going to be read anyway
+			if(!m_ptyReader)
+				m_slavePtyProcess->setReadNotificationEnabled(false);
+			m_continueTimer->start();
+			break;
+		}
+	}
+	// view gets changes of every slice, so it can paint while a flood is parsed,
+	// slice ending inside synchronized update is deferred by publishSnapshot()
+	if(!m_damage.isEmpty())
+		publishSnapshot();
+#ifdef LOG_THROUGHPUT
+	qint64 slice_nsecs = tm.nsecsElapsed();
+	nsecs_spent += slice_nsecs;
+	max_slice_nsecs = qMax(max_slice_nsecs, slice_nsecs);
+	if(bytes_processed >= 16 * 1024 * 1024) {
+		double mb = bytes_processed / (1024. * 1024.);
+		LOGDEB() << "processed" << mb << "MB at" << (mb * 1e9 / nsecs_spent) << "MB/s, longest slice" << (max_slice_nsecs / 1e6) << "ms";
+		bytes_processed = 0;
+		nsecs_spent = 0;
+		max_slice_nsecs = 0;
+	}
+#endif
+}
+
+int TerminalEmulator::nextInput()
+{
+	m_inputReadPos = 0;
+	m_inputWritePos = 0;
+	if(m_ptyReader) {
+		// parsed chunk goes back to reader
+		if(m_input)
+			m_ptyReader->release();
+		m_input = 0;
+		const char *data;
+		int n = m_ptyReader->acquire(&data);
+		if(n > 0) {
+			m_input = data;
+			m_inputWritePos = n;
+		}
+		return n;
+	}
+	qint64 n = m_slavePtyProcess->read(m_inputBuffer.data(), m_inputBuffer.size());
+	if(n > 0) {
+		m_input = m_inputBuffer.constData();
+		m_inputWritePos = n;
+	}
+	return n;
+}
@@ -0,0 +1,86 @@
+#ifndef TERMINALEMULATOR_H
+#define TERMINALEMULATOR_H
+
+#include "screensnapshot.h"
+
+#include <core/util/triplebuffer.h>
+
+#include <QObject>
+#include <QByteArray>
+#include <QSize>
+#include <QRect>
+
+class QTimer;
+
+namespace core {
+namespace term {
+
+class ScreenBuffer;
+class SlavePtyProcess;
+class PtyReader;
+
+// Parser and screen buffer of terminal, it can live on its own thread.
+// Every processed input slice is published as ScreenSnapshot for the view.
+class TerminalEmulator : public QObject
+{
+	Q_OBJECT
+public:
+	explicit TerminalEmulator(SlavePtyProcess *pty_process, QObject *parent = 0);
+	virtual ~TerminalEmulator();
+public:
+	bool hasPtyReaderThread() const;
+	/// snapshots for view thread, see core::util::TripleBuffer
+	core::util::TripleBuffer<ScreenSnapshot>& snapshots() {return m_snapshots;}
+public slots:
+	void setTerminalSize(const QSize &cols_rows);
+	/// lines of history shown above the screen
+	void setViewOffset(int history_lines_offset);
+signals:
+	void snapshotReady();
+private slots:
+	void onPtyProcessReadyRead();
+	/// parse input until PTY is drained or time budget is spent
+	void processInputSlice();
+	void onDirtyRegion(const QRect &rect);
+	void onScrolled(int lines);
+	void onSynchronizedUpdateFinished();
+private:
+	/// next block of input to m_input, returns its size, 0 when nothing is available now, -1 at the end of input
+	int nextInput();
+	void publishSnapshot();
+private:
+	static const int InputBufferSize = 64 * 1024;
+	// input is parsed in chunks, time budget is checked after every chunk
+	static const int ParseChunkSize = 8 * 1024;
+	// longest time parser thread is busy without publishing a snapshot,
+	// key presses wait at most this long when parser runs on GUI thread
+	static const int SliceBudgetMs = 4;
+
+	SlavePtyProcess *m_slavePtyProcess;
+	ScreenBuffer *m_screenBuffer;
+	// reader thread, 0 if PTY is read on the parser thread to m_inputBuffer
+	PtyReader *m_ptyReader;
+	// preallocated input arena used without reader thread
+	QByteArray m_inputBuffer;
+	// current input block, reader chunk or m_inputBuffer, bytes between read and write position are not parsed yet
+	const char *m_input;
+	int m_inputReadPos;
+	int m_inputWritePos;
+	// schedules next slice when input remains after the time budget is spent
+	QTimer *m_continueTimer;
+
+	core::util::TripleBuffer<ScreenSnapshot> m_snapshots;
+	// damage since the last published snapshot
+	ScreenDamage m_damage;
+	// damage of published snapshots not taken by view yet
+	ScreenDamage m_publishedDamage;
+	qint64 m_scrolledLines;
+	int m_viewOffset;
+	// snapshot was not published because of synchronized update, it is published when update finishes
+	bool m_snapshotDeferred;
+};
+
+}
+}
+
+#endif // TERMINALEMULATOR_H
@@ -0,0 +1,70 @@
+#ifndef BYTESCAN_H
+#define BYTESCAN_H
+
+#include <QtGlobal>
+
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace core {
+namespace util {
+
+// Byte scanning helpers for the terminal input hot path.
+// AVX2 is used only when the compiler targets it (-mavx2), SSE2 is always
+// available on x86_64, other platforms fall back to 8 bytes at a time.
+
+/// returns length of leading printable ASCII characters, bytes in range <0x20, 0x7e>
+inline int printableAsciiLength(const char *data, int length)
+{
+	int i = 0;
+#if defined(__AVX2__)
+	const __m256i space_1 = _mm256_set1_epi8(0x1f);
+	const __m256i del = _mm256_set1_epi8(0x7f);
+	for(; i + 32 <= length; i += 32) {
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+		// signed compare, bytes >= 0x80 are negative
+		__m256i printable = _mm256_andnot_si256(_mm256_cmpeq_epi8(v, del), _mm256_cmpgt_epi8(v, space_1));
+		unsigned mask = ~static_cast<unsigned>(_mm256_movemask_epi8(printable));
+		if(mask)
+			return i + __builtin_ctz(mask);
+	}
+#elif defined(__SSE2__)
+	const __m128i space_1 = _mm_set1_epi8(0x1f);
+	const __m128i del = _mm_set1_epi8(0x7f);
+	for(; i + 16 <= length; i += 16) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		// signed compare, bytes >= 0x80 are negative
+		__m128i printable = _mm_andnot_si128(_mm_cmpeq_epi8(v, del), _mm_cmpgt_epi8(v, space_1));
+		unsigned mask = ~static_cast<unsigned>(_mm_movemask_epi8(printable)) & 0xffff;
+		if(mask)
+			return i + __builtin_ctz(mask);
+	}
+#else
+	const quint64 ones = Q_UINT64_C(0x0101010101010101);
+	const quint64 high_bits = Q_UINT64_C(0x8080808080808080);
+	for(; i + 8 <= length; i += 8) {
+		quint64 v;
+		::memcpy(&v, data + i, sizeof(v));
+		quint64 del = v ^ (ones * 0x7f);
+		// any byte >= 0x80, < 0x20 or == 0x7f
+		if((v | ((v - ones * 0x20) & ~v) | ((del - ones) & ~del)) & high_bits)
+			break;
+	}
+#endif
+	for(; i < length; i++) {
+		uchar c = static_cast<uchar>(data[i]);
+		if(c < 0x20 || c >= 0x7f)
+			break;
+	}
+	return i;
+}
+
+}
+}
+
+#endif // BYTESCAN_H
@@ -1,56 +1,106 @@
 #ifndef RINGBUFFER_H
 #define RINGBUFFER_H
 
-#include <QList>
+#include <QVector>
 
 namespace core {
 namespace util {
 
+// Ring of items with power of 2 capacity, index is masked instead of computing modulo.
+// Slots are never freed, evicted or removed item stays in its slot,
+// so the caller can refill it in place and reuse its storage (see appendSlot()).
 template<class T>
 class RingBuffer
 {
 public:
-	RingBuffer(int max_size = 1024)
-	: m_maxSize(max_size), m_head(0)
+	static const int MaxCapacity = 1 << 24;
+public:
+	/// capacity is rounded up to the nearest power of 2
+	RingBuffer(int capacity = 1024)
+	: m_first(0), m_count(0)
+	{
+		setCapacity(capacity);
+	}
+	int capacity() const
+	{
+		return m_mask + 1;
+	}
+	/// all items are dropped
+	void setCapacity(int capacity)
 	{
+		int c = 1;
+		while(c < capacity && c < MaxCapacity)
+			c <<= 1;
+		m_mask = c - 1;
+		m_data = QVector<T>();
+		clear();
 	}
 	int count() const
 	{
-		return m_data.size();
+		return m_count;
 	}
-	void append(const T &item)
+	/// next append evicts the oldest item
+	bool isFull() const
+	{
+		return m_count > m_mask;
+	}
+	void clear()
+	{
+		m_first = 0;
+		m_count = 0;
+	}
+	/// returns slot for next item, the oldest item is evicted if the ring is full,
+	/// slot content is a previously evicted or removed item or default constructed T
+	T& appendSlot()
 	{
-		if(m_data.size() < m_maxSize) {
-			m_data.append(item);
+		int ix;
+		if(m_count > m_mask) {
+			ix = m_first;
+			m_first = (m_first + 1) & m_mask;
 		}
 		else {
-			m_data[m_head] = item;
+			ix = (m_first + m_count) & m_mask;
+			m_count++;
 		}
-		m_head++;
-		if(m_head >= m_maxSize)
-			m_head -= m_maxSize;
+		// storage grows lazily up to capacity
+		if(ix == m_data.size())
+			m_data.append(T());
+		return m_data[ix];
+	}
+	void append(const T &item)
+	{
+		appendSlot() = item;
+	}
+	/// item storage stays in its slot for reuse
+	void removeLast()
+	{
+		if(m_count > 0)
+			m_count--;
 	}
 	T& at(int ix)
 	{
 		return m_data[bufferIndex(ix)];
 	}
+	const T& at(int ix) const
+	{
+		return m_data[bufferIndex(ix)];
+	}
 	T value(int ix) const
 	{
-		return m_data.value(bufferIndex(ix));
+		if(ix < 0 || ix >= m_count)
+			return T();
+		return m_data[bufferIndex(ix)];
 	}
 private:
 	int bufferIndex(int logical_index) const
 	{
-		if(m_maxSize == m_data.size()) {
-			logical_index += m_head;
-			logical_index %= m_maxSize;
-		}
-		return logical_index;
+		return (m_first + logical_index) & m_mask;
 	}
 private:
-	QList<T> m_data;
-	int m_maxSize;
-	int m_head;
+	QVector<T> m_data;
+	int m_mask;
+	int m_first;
+	int m_count;
 };
 
 }
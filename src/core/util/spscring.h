@@ -0,0 +1,101 @@
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <QAtomicInt>
+#include <QVector>
+
+namespace core {
+namespace util {
+
+// Lock-free ring for exactly one producer thread and one consumer thread.
+// Slots are preallocated and never freed, producer fills writeSlot() in place and publishes it,
+// consumer processes readSlot() in place and releases it back to the producer.
+// Positions run modulo 2 * capacity, so full and empty ring can be told apart without a counter.
+template<class T>
+class SpscRing
+{
+public:
+	/// capacity is rounded up to the nearest power of 2
+	explicit SpscRing(int capacity)
+	: m_head(0), m_tail(0), m_producerHead(0), m_consumerTail(0)
+	{
+		int c = 1;
+		while(c < capacity)
+			c <<= 1;
+		m_mask = c - 1;
+		m_data.resize(c);
+	}
+	int capacity() const
+	{
+		return m_mask + 1;
+	}
+	/// for initialization of slots before any thread is started
+	T& slotAt(int ix)
+	{
+		return m_data[ix];
+	}
+
+	/// producer side, free slot or 0 when ring is full
+	T* writeSlot()
+	{
+		int used = (m_producerHead - loadAcquire(m_tail)) & positionMask();
+		if(used == capacity())
+			return 0;
+		return m_data.data() + (m_producerHead & m_mask);
+	}
+	/// producer side, slot returned by writeSlot() becomes visible to consumer
+	void publish()
+	{
+		m_producerHead = (m_producerHead + 1) & positionMask();
+		storeRelease(m_head, m_producerHead);
+	}
+
+	/// consumer side, the oldest published slot or 0 when ring is empty
+	T* readSlot()
+	{
+		if(loadAcquire(m_head) == m_consumerTail)
+			return 0;
+		return m_data.data() + (m_consumerTail & m_mask);
+	}
+	/// consumer side, slot returned by readSlot() is given back to producer
+	void release()
+	{
+		m_consumerTail = (m_consumerTail + 1) & positionMask();
+		storeRelease(m_tail, m_consumerTail);
+	}
+private:
+	int positionMask() const
+	{
+		return (m_mask << 1) | 1;
+	}
+	static int loadAcquire(QAtomicInt &a)
+	{
+#if QT_VERSION < 0x050000
+		return a.fetchAndAddAcquire(0);
+#else
+		return a.loadAcquire();
+#endif
+	}
+	static void storeRelease(QAtomicInt &a, int v)
+	{
+#if QT_VERSION < 0x050000
+		a.fetchAndStoreRelease(v);
+#else
+		a.storeRelease(v);
+#endif
+	}
+private:
+	QVector<T> m_data;
+	int m_mask;
+	// published positions, written by one side and read by the other one
+	QAtomicInt m_head;
+	QAtomicInt m_tail;
+	// private copies of own position, no atomic access needed
+	int m_producerHead;
+	int m_consumerTail;
+};
+
+}
+}
+
+#endif // SPSCRING_H
@@ -0,0 +1,65 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <QAtomicInt>
+
+namespace core {
+namespace util {
+
+// Lock-free handover of the latest value from one producer thread to one consumer thread.
+// Producer fills back() and publishes it, consumer takes the latest published value by update()
+// and reads front() until the next update(). Neither side ever waits, values published
+// faster than consumed are skipped. Items are reused, so their storage is allocated once.
+template<class T>
+class TripleBuffer
+{
+public:
+	TripleBuffer()
+	: m_back(0), m_middle(1), m_front(2)
+	{
+	}
+
+	/// producer side, item to be filled and published
+	T& back()
+	{
+		return m_items[m_back];
+	}
+	/// producer side, back() becomes the latest value, producer gets another item as back()
+	void publish()
+	{
+		m_back = m_middle.fetchAndStoreOrdered(m_back | FreshBit) & IndexMask;
+	}
+	/// producer side, false when the last published value was not taken by consumer yet
+	bool isConsumed()
+	{
+		return !(m_middle.fetchAndAddOrdered(0) & FreshBit);
+	}
+
+	/// consumer side, takes the latest published value, returns false if there is nothing new
+	bool update()
+	{
+		if(!(m_middle.fetchAndAddOrdered(0) & FreshBit))
+			return false;
+		m_front = m_middle.fetchAndStoreOrdered(m_front) & IndexMask;
+		return true;
+	}
+	/// consumer side
+	const T& front() const
+	{
+		return m_items[m_front];
+	}
+private:
+	enum {IndexMask = 3, FreshBit = 4};
+	T m_items[3];
+	// owned by producer
+	int m_back;
+	// index of the latest published item, FreshBit is set until consumer takes it
+	QAtomicInt m_middle;
+	// owned by consumer
+	int m_front;
+};
+
+}
+}
+
+#endif // TRIPLEBUFFER_H
@@ -0,0 +1,91 @@
+#ifndef UTF8DECODER_H
+#define UTF8DECODER_H
+
+#include <QtGlobal>
+
+namespace core {
+namespace util {
+
+// Incremental UTF-8 decoder, a partial sequence is kept between calls,
+// so a multibyte character split between two reads is decoded correctly.
+// Malformed input is replaced by U+FFFD.
+class Utf8Decoder
+{
+public:
+	static const uint ReplacementCharacter = 0xfffd;
+public:
+	Utf8Decoder() {reset();}
+
+	void reset()
+	{
+		m_codePoint = 0;
+		m_remaining = 0;
+		m_lower = 0x80;
+		m_upper = 0xbf;
+	}
+	/// true if there is no partial sequence pending
+	bool isIdle() const {return m_remaining == 0;}
+	/// decode next byte, out must have space for 2 code points
+	/// returns number of code points stored in out
+	int decode(uchar b, uint *out)
+	{
+		if(m_remaining == 0)
+			return decodeLeadByte(b, out);
+		if(b < m_lower || b > m_upper) {
+			// broken sequence, byte b starts a new one
+			reset();
+			out[0] = ReplacementCharacter;
+			return 1 + decodeLeadByte(b, out + 1);
+		}
+		m_lower = 0x80;
+		m_upper = 0xbf;
+		m_codePoint = (m_codePoint << 6) | (b & 0x3f);
+		if(--m_remaining == 0) {
+			out[0] = m_codePoint;
+			return 1;
+		}
+		return 0;
+	}
+private:
+	int decodeLeadByte(uchar b, uint *out)
+	{
+		if(b < 0x80) {
+			out[0] = b;
+			return 1;
+		}
+		if(b >= 0xc2 && b <= 0xdf) {
+			m_remaining = 1;
+			m_codePoint = b & 0x1f;
+		}
+		else if(b >= 0xe0 && b <= 0xef) {
+			m_remaining = 2;
+			m_codePoint = b & 0x0f;
+			// reject overlong forms and surrogates
+			if(b == 0xe0) m_lower = 0xa0;
+			else if(b == 0xed) m_upper = 0x9f;
+		}
+		else if(b >= 0xf0 && b <= 0xf4) {
+			m_remaining = 3;
+			m_codePoint = b & 0x07;
+			// reject overlong forms and code points > U+10FFFF
+			if(b == 0xf0) m_lower = 0x90;
+			else if(b == 0xf4) m_upper = 0x8f;
+		}
+		else {
+			// continuation byte without lead byte, or invalid lead byte
+			out[0] = ReplacementCharacter;
+			return 1;
+		}
+		return 0;
+	}
+private:
+	uint m_codePoint;
+	int m_remaining;
+	uchar m_lower;
+	uchar m_upper;
+};
+
+}
+}
+
+#endif // UTF8DECODER_H
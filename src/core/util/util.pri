@@ -1,6 +1,10 @@
 HEADERS += \
 	$$PWD/log.h \
 	$$PWD/ringbuffer.h \
+	$$PWD/spscring.h \
+	$$PWD/triplebuffer.h \
+	$$PWD/utf8decoder.h \
+	$$PWD/bytescan.h \
 
 SOURCES += \
     $$PWD/log.cpp
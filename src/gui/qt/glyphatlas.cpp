@@ -0,0 +1,108 @@
+#include "glyphatlas.h"
+
+#include <QPainter>
+#include <QFontMetrics>
+
+//#define NO_BBTERM_LOG_DEBUG
+#include <core/util/log.h>
+
+using namespace gui::qt;
+
+GlyphAtlas::GlyphAtlas()
+: m_charWidth(0), m_charHeight(0), m_baseline(0), m_tileCount(0)
+{
+}
+
+void GlyphAtlas::setFont(const QFont &font, int char_width, int char_height, int baseline)
+{
+	m_font = font;
+	m_charWidth = char_width;
+	m_charHeight = char_height;
+	m_baseline = baseline;
+	clear();
+	m_runImage = QImage();
+}
+
+void GlyphAtlas::clear()
+{
+	m_pages.clear();
+	m_entries.clear();
+	m_tileCount = 0;
+}
+
+QRect GlyphAtlas::entryRect(int entry) const
+{
+	int ix = tileIndex(entry) % (TilesPerRow * TileRowsPerPage);
+	int width = (entry & WideEntryFlag)? 2 * m_charWidth: m_charWidth;
+	return QRect((ix % TilesPerRow) * m_charWidth, (ix / TilesPerRow) * m_charHeight, width, m_charHeight);
+}
+
+int GlyphAtlas::tileEntry(ushort code)
+{
+	QHash<ushort, int>::const_iterator it = m_entries.constFind(code);
+	if(it != m_entries.constEnd())
+		return it.value();
+
+	// double width (CJK) glyph gets two tiles of the same tile row
+	bool is_wide = QFontMetrics(m_font).width(QChar(code)) > m_charWidth;
+	int tile_ix = m_tileCount;
+	if(is_wide && tile_ix % TilesPerRow == TilesPerRow - 1)
+		tile_ix++;
+	if(tile_ix + (is_wide? 1: 0) >= MaxPageCount * TilesPerRow * TileRowsPerPage) {
+		LOGDEB() << "glyph atlas is full, clearing it";
+		clear();
+		tile_ix = 0;
+	}
+	int page_ix = tile_ix / (TilesPerRow * TileRowsPerPage);
+	if(page_ix == m_pages.count()) {
+		QImage page(TilesPerRow * m_charWidth, TileRowsPerPage * m_charHeight, QImage::Format_ARGB32_Premultiplied);
+		page.fill(0);
+		m_pages.append(page);
+	}
+	int entry = tile_ix | (is_wide? WideEntryFlag: 0);
+	QRect r = entryRect(entry);
+	QPainter painter(&m_pages[page_ix]);
+	painter.setClipRect(r);
+	painter.setFont(m_font);
+	// coverage mask, color is applied when text is painted
+	painter.setPen(Qt::white);
+	painter.drawText(r.x(), r.y() + m_baseline, QString(QChar(code)));
+	m_entries.insert(code, entry);
+	m_tileCount = tile_ix + (is_wide? 2: 1);
+	return entry;
+}
+
+void GlyphAtlas::drawText(QPainter *painter, int px_x, int px_y, const QString &text, const QColor &color, bool underline)
+{
+	if(m_charWidth <= 0 || m_charHeight <= 0 || text.isEmpty())
+		return;
+	// wide glyph at the end of run overflows by one cell
+	int run_width = (text.length() + 1) * m_charWidth;
+	if(m_runImage.width() < run_width)
+		m_runImage = QImage(run_width, m_charHeight, QImage::Format_ARGB32_Premultiplied);
+	QPainter run_painter(&m_runImage);
+	run_painter.setCompositionMode(QPainter::CompositionMode_Source);
+	run_painter.fillRect(0, 0, run_width, m_charHeight, Qt::transparent);
+	// wide glyph and its right neighbour share a cell, masks are merged
+	run_painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+	int painted_width = 0;
+	const QChar *chars = text.constData();
+	for(int i=0; i<text.length(); i++) {
+		ushort code = chars[i].unicode();
+		if(code == ' ')
+			continue;
+		int entry = tileEntry(code);
+		QRect r = entryRect(entry);
+		run_painter.drawImage(QPoint(i * m_charWidth, 0), m_pages.at(tileIndex(entry) / (TilesPerRow * TileRowsPerPage)), r);
+		painted_width = qMax(painted_width, i * m_charWidth + r.width());
+	}
+	if(painted_width > 0) {
+		// one fill tints all masks of run with text color
+		run_painter.setCompositionMode(QPainter::CompositionMode_SourceIn);
+		run_painter.fillRect(0, 0, painted_width, m_charHeight, color);
+		run_painter.end();
+		painter->drawImage(QPoint(px_x, px_y), m_runImage, QRect(0, 0, painted_width, m_charHeight));
+	}
+	if(underline)
+		painter->fillRect(px_x, px_y + m_baseline + 1, text.length() * m_charWidth, 1, color);
+}
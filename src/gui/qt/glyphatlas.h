@@ -0,0 +1,61 @@
+#ifndef GUI_QT_GLYPHATLAS_H
+#define GUI_QT_GLYPHATLAS_H
+
+#include <QImage>
+#include <QFont>
+#include <QHash>
+#include <QVector>
+
+class QPainter;
+
+namespace gui {
+namespace qt {
+
+// Cache of rasterized glyphs for fixed pitch grid.
+// Every code point is drawn once by QPainter::drawText to a tile of atlas page as coverage mask
+// (white glyph with alpha). Text run is composed from masks to a scratch image, which is tinted
+// with text color and blitted over already filled background, so colors and underline
+// do not multiply the tiles. Glyph wider than cell (CJK) gets two adjacent tiles,
+// it overflows to the next cell, the same as with QPainter::drawText.
+// Atlas is cleared when font changes or when all pages are full.
+class GlyphAtlas
+{
+public:
+	static const int TilesPerRow = 64;
+	static const int TileRowsPerPage = 32;
+	static const int MaxPageCount = 4;
+public:
+	GlyphAtlas();
+
+	/// clears atlas, baseline is distance of text baseline from top of cell
+	void setFont(const QFont &font, int char_width, int char_height, int baseline);
+	/// paint text at px_x, px_y (top left corner of the first cell), spaces are skipped
+	void drawText(QPainter *painter, int px_x, int px_y, const QString &text, const QColor &color, bool underline);
+	void clear();
+private:
+	/// tile entry of glyph, the glyph is rasterized on the first use
+	int tileEntry(ushort code);
+	/// rect of entry on its page, wide entry covers two tiles
+	QRect entryRect(int entry) const;
+	static int tileIndex(int entry) {return entry & ~WideEntryFlag;}
+private:
+	// entry of glyph wider than cell
+	static const int WideEntryFlag = 0x40000000;
+
+	QFont m_font;
+	int m_charWidth;
+	int m_charHeight;
+	int m_baseline;
+	QVector<QImage> m_pages;
+	// code point -> tile index | WideEntryFlag
+	QHash<ushort, int> m_entries;
+	// tiles in use, wide entry takes two of them
+	int m_tileCount;
+	// text run is composed and tinted here, it grows to the longest run painted
+	QImage m_runImage;
+};
+
+}
+}
+
+#endif // GUI_QT_GLYPHATLAS_H
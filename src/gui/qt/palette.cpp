@@ -23,6 +23,7 @@ Palette::Palette()
 	m_colors[13] = QColor(255, 0, 255);		// Bright magenta
 	m_colors[14] = QColor(0, 255, 255);		// Bright cyan
 	m_colors[15] = QColor(255, 255, 255);	// White
+	rebuild();
 }
 
 Palette::~Palette() 
@@ -30,6 +31,39 @@ Palette::~Palette()
 	// TODO Auto-generated destructor stub
 }
 
+void Palette::setColor(int index, const QColor &color)
+{
+	if(index < 0 || index >= ColorCount) {
+		LOGWARN() << "color index out of range:" << index;
+		return;
+	}
+	m_colors[index] = color;
+	rebuild();
+}
+
+void Palette::rebuild()
+{
+	for(int i=0; i<ColorCount; i++) {
+		m_pens[i] = QPen(m_colors[i]);
+		m_brushes[i] = QBrush(m_colors[i]);
+	}
+	const int color_mask = (1 << ColorBits) - 1;
+	for(int key=0; key<StyleKeyCount; key++) {
+		int fg = key & color_mask;
+		int bg = (key >> ColorBits) & color_mask;
+		bool bright = key & (1 << (2 * ColorBits));
+		bool reverse = key & (2 << (2 * ColorBits));
+		if(reverse)
+			qSwap(fg, bg);
+		// colors 8-15 are not used by cells, they are the bright variants
+		fg &= 7;
+		bg &= 7;
+		// bright applies to foreground only
+		m_styles[key].fg = bright? fg + 8: fg;
+		m_styles[key].bg = bg;
+	}
+}
+
 QColor Palette::getColor(int index, bool highlight) 
 {
 	if (index < 8) {
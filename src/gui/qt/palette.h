@@ -1,20 +1,55 @@
 #ifndef GUI_QT_PALETTE_H
 #define GUI_QT_PALETTE_H
 
+#include <core/term/screencell.h>
+
 #include <QColor>
+#include <QPen>
+#include <QBrush>
 
 namespace gui {
 namespace qt {
 
+// Palette compiled to lookup tables.
+// Style key packs everything what decides cell colors (fg, bg, bright and reverse attributes),
+// for every key there is precomputed index of pen and brush, so renderer does no color logic per run.
+// Tables are rebuilt when a color changes.
 class Palette 
 {
+public:
+	// 8 normal + 8 bright colors, index type allows extension up to 256 colors
+	static const int ColorCount = 16;
+	static const int ColorBits = 4;
+	static const int StyleKeyCount = 1 << (2 * ColorBits + 2);
 public:
 	Palette();
 	virtual ~Palette();
 
 	QColor getColor(int index, bool highlight);
+	void setColor(int index, const QColor &color);
+
+	static int styleKey(const core::term::ScreenCell &cell)
+	{
+		int attrs = cell.attributes();
+		return cell.fgColor() | (cell.bgColor() << ColorBits)
+				| ((attrs & core::term::ScreenCell::AttrBright)? (1 << (2 * ColorBits)): 0)
+				| ((attrs & core::term::ScreenCell::AttrReverse)? (2 << (2 * ColorBits)): 0);
+	}
+	const QColor& fgColor(int style_key) const {return m_colors[m_styles[style_key].fg];}
+	const QPen& pen(int style_key) const {return m_pens[m_styles[style_key].fg];}
+	const QBrush& brush(int style_key) const {return m_brushes[m_styles[style_key].bg];}
+private:
+	void rebuild();
 private:
-	QColor m_colors[16];
+	struct Style
+	{
+		quint8 fg;
+		quint8 bg;
+	};
+	QColor m_colors[ColorCount];
+	QPen m_pens[ColorCount];
+	QBrush m_brushes[ColorCount];
+	Style m_styles[StyleKeyCount];
 };
 
 }
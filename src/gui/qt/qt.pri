@@ -2,11 +2,13 @@ SOURCES += \
     $$PWD/mainwindow.cpp \
 	$$PWD/terminalwidget.cpp \
 	$$PWD/palette.cpp \
+	$$PWD/glyphatlas.cpp \
 
 HEADERS  += \
 	$$PWD/mainwindow.h \
 	$$PWD/terminalwidget.h \
 	$$PWD/palette.h \
+	$$PWD/glyphatlas.h \
 
 FORMS += \
 	$$PWD/mainwindow.ui \
@@ -1,6 +1,6 @@
 #include "terminalwidget.h"
 
-#include <core/term/screenbuffer.h>
+#include <core/term/screensnapshot.h>
 #include <core/term/slaveptyprocess.h>
 #include <core/term/terminal.h>
 #ifdef Q_OS_QNX
@@ -10,16 +10,49 @@
 #include <QPainter>
 #include <QColor>
 #include <QSwipeGesture>
+#include <QImage>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QApplication>
+#include <QClipboard>
 
 //#define NO_BBTERM_LOG_DEBUG
 #include <core/util/log.h>
 
+//#define LOG_DAMAGE
+//#define LOG_FRAME_RATE
+
 using namespace gui::qt;
 
+int TerminalWidget::s_defaultFrameRate = TerminalWidget::DefaultFrameRate;
+
 TerminalWidget::TerminalWidget(QWidget *parent)
-: QWidget(parent), m_historyLinesOffset(0), m_horizontalScrollPx(0)
+: QWidget(parent), m_terminal(0), m_historyLinesOffset(0), m_horizontalScrollPx(0), m_frameScrolledLines(0), m_frameHistoryOffset(0)
 {
+	m_frameIntervalMs = (s_defaultFrameRate > 0)? 1000 / s_defaultFrameRate: 0;
+	m_frameTimer = new QTimer(this);
+	m_frameTimer->setSingleShot(true);
+	connect(m_frameTimer, SIGNAL(timeout()), this, SLOT(flushFrame()));
+	// BBTERM_GLYPH_ATLAS=0 switches back to QPainter::drawText, for comparison
+	m_useGlyphAtlas = (qgetenv("BBTERM_GLYPH_ATLAS") != "0");
 	setupFont(8);
+	m_textBuffer.reserve(TextBufferCapacity);
+	if(!qgetenv("BBTERM_PAINT_BENCHMARK").isEmpty())
+		runPaintBenchmark();
+	m_keyLatencyProbeTimer = 0;
+	if(qgetenv("BBTERM_KEY_LATENCY") == "1") {
+		// key press latency during output flood, compare with BBTERM_PARSER_THREAD=0
+		m_maxEventLoopDelayNsecs = 0;
+		m_maxKeyWriteNsecs = 0;
+		m_keyCount = 0;
+		m_queuedKeyCount = 0;
+		m_keyLatencyProbeTimer = new QTimer(this);
+		m_keyLatencyProbeTimer->setInterval(KeyLatencyProbeIntervalMs);
+		connect(m_keyLatencyProbeTimer, SIGNAL(timeout()), this, SLOT(probeKeyLatency()));
+		m_keyLatencyProbeTime.start();
+		m_keyLatencyReportTime.start();
+		m_keyLatencyProbeTimer->start();
+	}
 #ifdef Q_OS_QNX
 	// do not work, should be???
 	//grabGesture(Qt::SwipeGesture);
@@ -53,19 +86,104 @@ void TerminalWidget::setupFont(int point_size)
 		m_charHeightPx = metrics.lineSpacing();
 		m_charShiftPx = m_charHeightPx / 5;
 		LOGDEB() << "char width:" << m_charWidthPx << "height:" << m_charHeightPx << "leading:" << m_charShiftPx;
+		m_glyphAtlas.setFont(m_font, m_charWidthPx, m_charHeightPx, m_charHeightPx - m_charShiftPx);
 }
 
-void TerminalWidget::invalidateRegion(const QRect &dirty_rect)
+void TerminalWidget::setDefaultFrameRate(int hz)
 {
-	//LOGDEB() << Q_FUNC_INFO;
-	Q_UNUSED(dirty_rect);
-	update();
+	s_defaultFrameRate = hz;
 }
 
 void TerminalWidget::invalidateAll()
 {
-	core::term::ScreenBuffer *screen_buffer = m_terminal->screenBuffer();
-	invalidateRegion(QRect(QPoint(0, 0), screen_buffer->terminalSize()));
+	update();
+}
+
+void TerminalWidget::scheduleFrame()
+{
+	if(m_frameTimer->isActive())
+		return;
+	qint64 wait_ms = m_frameIntervalMs;
+	if(m_lastFrameTime.isValid())
+		wait_ms -= m_lastFrameTime.elapsed();
+	// when idle the frame is flushed as soon as the current input chunk is processed,
+	// input coming faster than frame rate is parsed meanwhile and painted once
+	m_frameTimer->start(static_cast<int>(qMax(wait_ms, Q_INT64_C(0))));
+}
+
+void TerminalWidget::flushFrame()
+{
+	m_frameTimer->stop();
+	m_lastFrameTime.start();
+#ifdef LOG_FRAME_RATE
+	static int frame_count = 0;
+	static QElapsedTimer frame_rate_timer;
+	if(!frame_rate_timer.isValid())
+		frame_rate_timer.start();
+	frame_count++;
+	if(frame_rate_timer.elapsed() >= 1000) {
+		LOGDEB() << "frames/s:" << (frame_count * 1000.0 / frame_rate_timer.restart());
+		frame_count = 0;
+	}
+#endif
+	if(!m_terminal)
+		return;
+	bool is_new = m_terminal->updateSnapshot();
+	const core::term::ScreenSnapshot &snapshot = m_terminal->snapshot();
+	if(!is_new)
+		return;
+	if(m_historyLinesOffset > snapshot.historyCount) {
+		// cold history block was dropped, emulator has already clamped this snapshot,
+		// keep its offset in sync, so it does not jump back when history grows again
+		m_historyLinesOffset = snapshot.historyCount;
+		m_terminal->setViewOffset(m_historyLinesOffset);
+	}
+	if(snapshot.damage.isFull || snapshot.terminalSize != m_frameTerminalSize) {
+		update();
+	}
+	else {
+		// content moves up when screen scrolls and down when more history is shown
+		qint64 dy_lines = (snapshot.historyOffset - m_frameHistoryOffset) - (snapshot.scrolledLines - m_frameScrolledLines);
+		if(qAbs(dy_lines) >= snapshot.terminalSize.height())
+			update();
+		else
+			blit(0, static_cast<int>(dy_lines) * m_charHeightPx);
+		if((snapshot.historyOffset == 0) != (m_frameHistoryOffset == 0)) {
+			// cursor is painted only without history offset, repaint its old (already moved) and new place
+			QPoint old_pos = m_frameCursorPosition;
+			update(QRect(old_pos.x() * m_charWidthPx - m_horizontalScrollPx, (old_pos.y() + m_frameHistoryOffset + static_cast<int>(dy_lines)) * m_charHeightPx, m_charWidthPx, m_charHeightPx));
+			QPoint new_pos = snapshot.cursorPosition;
+			update(QRect(new_pos.x() * m_charWidthPx - m_horizontalScrollPx, (new_pos.y() + snapshot.historyOffset) * m_charHeightPx, m_charWidthPx, m_charHeightPx));
+		}
+		// damage rows are absolute lines, screen rows are shifted down when history is shown
+		qint64 first_line = snapshot.scrolledLines - snapshot.historyOffset;
+		for(int i=0; i<snapshot.damage.rects.count(); i++) {
+			const QRect &r = snapshot.damage.rects.at(i);
+			qint64 top = r.y() - first_line;
+			qint64 bottom = top + r.height();
+			if(bottom <= 0 || top >= snapshot.terminalSize.height())
+				continue;
+			top = qMax(top, Q_INT64_C(0));
+			update(QRect(r.x() * m_charWidthPx - m_horizontalScrollPx, static_cast<int>(top) * m_charHeightPx,
+						 r.width() * m_charWidthPx, static_cast<int>(bottom - top) * m_charHeightPx));
+		}
+	}
+	m_frameScrolledLines = snapshot.scrolledLines;
+	m_frameHistoryOffset = snapshot.historyOffset;
+	m_frameCursorPosition = snapshot.cursorPosition;
+	m_frameTerminalSize = snapshot.terminalSize;
+}
+
+void TerminalWidget::blit(int dx, int dy)
+{
+	if(dx == 0 && dy == 0)
+		return;
+	if(qAbs(dx) >= width() || qAbs(dy) >= height()) {
+		update();
+		return;
+	}
+	// Qt repaints exposed areas and moves pending dirty region as well
+	scroll(dx, dy);
 }
 
 void TerminalWidget::updateFocus(bool activate)
@@ -80,7 +198,7 @@ void TerminalWidget::setTerminal(core::term::Terminal *t)
 {
 	m_terminal = t;
 	if(m_terminal) {
-		connect(m_terminal->screenBuffer(), SIGNAL(dirtyRegion(QRect)), this, SLOT(invalidateRegion(QRect)));
+		connect(m_terminal, SIGNAL(snapshotReady()), this, SLOT(scheduleFrame()));
 	}
 	setupGeometry();
 }
@@ -88,90 +206,122 @@ void TerminalWidget::setTerminal(core::term::Terminal *t)
 void TerminalWidget::paintEvent(QPaintEvent *ev)
 {
 	//LOGDEB() << Q_FUNC_INFO;
-	Q_UNUSED(ev);
+#ifdef LOG_DAMAGE
+	static qint64 painted_px = 0;
+	static int paint_count = 0;
+	painted_px += ev->rect().width() * ev->rect().height();
+	if(++paint_count % 100 == 0) {
+		LOGDEB() << "paint events:" << paint_count << "average painted area:" << (painted_px / paint_count) << "px"
+				 << "of" << (width() * height());
+	}
+#endif
 	QPainter painter(this);
 	QColor fg_color(255,255,255);
 	QColor bg_color(8,0,0);
 	//painter.setBackgroundMode(Qt::TransparentMode);
 	painter.setPen(QPen(fg_color));
 	painter.setFont(m_font);
-	QRect r(QPoint(0, 0), geometry().size());
+	// paint only rows intersecting the dirty rect
+	const QRect &r = ev->rect();
 	painter.fillRect(r, QBrush(bg_color));
-	core::term::ScreenBuffer *screen_buffer = m_terminal->screenBuffer();
-	int row_count = screen_buffer->rowCount();
-	int start_line_ix = screen_buffer->firstVisibleLineIndex() - m_historyLinesOffset;
-	if(start_line_ix < 0)  start_line_ix = 0;
-	//LOGDEB() << start_ix << row_count;
-	for(int i=start_line_ix; i<row_count; i++) {
-		const core::term::ScreenLine screen_line = screen_buffer->lineAt(i);
-		QString line_str = screen_line.toString();
-		core::term::ScreenCell first_cell;
-		first_cell.setAttributes(0xff);
-		int term_y = i - start_line_ix;
-		int chunk_pos = 0;
-		int chunk_len = 0;
-		while(chunk_pos + chunk_len < line_str.length()) {
-			core::term::ScreenCell cell = screen_line.value(chunk_pos + chunk_len);
-			//int term_x = chunk_pos + chunk_len;
-			if(cell.isAllAttributesEqual(first_cell)) {
-				chunk_len++;
-			}
-			else {
-				if(chunk_len > 0) {
-					QString s = line_str.mid(chunk_pos, chunk_len);
-					paintText(&painter, QPoint(chunk_pos, term_y), s, first_cell);
-				}
-				first_cell = cell;
-				chunk_pos += chunk_len;
-				chunk_len = 0;
-			}
-		}
-		if(chunk_len > 0) {
-			QString s = line_str.mid(chunk_pos, chunk_len);
-			paintText(&painter, QPoint(chunk_pos, term_y), s, first_cell);
+	// snapshot is replaced only by flushFrame(), painted pixels and damage always belong to it
+	const core::term::ScreenSnapshot &snapshot = m_terminal->snapshot();
+	int first_row = qMax(r.top() / m_charHeightPx, 0);
+	int last_row = qMin(r.bottom() / m_charHeightPx, snapshot.rowCount() - 1);
+	for(int y=first_row; y<=last_row; y++) {
+		const core::term::ScreenLineView line = snapshot.lineView(y);
+		// paint runs of cells with the same attributes
+		for(int x=0; x<line.length(); ) {
+			int n = line.runLength(x);
+			paintText(&painter, QPoint(x, y), runText(line, x, n), line.at(x));
+			x += n;
 		}
 	}
-	if(m_historyLinesOffset == 0) {
+	if(snapshot.historyOffset == 0 && snapshot.rowCount() > 0) {
 		// print cursor
-		QPoint cursor_pos = screen_buffer->cursorPosition();
-		const core::term::ScreenLine screen_line = screen_buffer->lineAt(start_line_ix + cursor_pos.y());
-		core::term::ScreenCell cell = screen_line.value(cursor_pos.x());
+		QPoint cursor_pos = snapshot.cursorPosition;
+		// cursor is behind the last column when auto wrap is pending
+		int last_col = snapshot.terminalSize.width() - 1;
+		if(cursor_pos.x() > last_col && last_col >= 0) cursor_pos.setX(last_col);
+		const core::term::ScreenLineView line = snapshot.lineView(cursor_pos.y());
+		core::term::ScreenCell cell = line.value(cursor_pos.x());
 		if(cell.isNull()) cell.setLetter(' ');
 		// flip reverse attribute
 		int atts = cell.attributes();
 		atts = atts ^ core::term::ScreenCell::AttrReverse;
 		cell.setAttributes(atts);
-		paintText(&painter, cursor_pos, QString(cell.letter()), cell);
+		core::term::ScreenLineView cursor_line(&cell, 1);
+		paintText(&painter, cursor_pos, runText(cursor_line, 0, 1), cell);
 	}
 }
 
-void TerminalWidget::paintText(QPainter *painter, const QPoint &term_pos, const QString &text, const core::term::ScreenCell &text_attrs)
+void TerminalWidget::runPaintBenchmark()
 {
-	int px_x = term_pos.x() * m_charWidthPx - m_horizontalScrollPx;
-	int px_y = term_pos.y() * m_charHeightPx;
-	//LOGDEB() << term_pos.x() << term_pos.y() << text;
-	QRect r(px_x, px_y, text.length() * m_charWidthPx, m_charHeightPx);
-	painter->fillRect(r, brushForCell(text_attrs));
-	painter->setPen(penForCell(text_attrs));
-	painter->drawText(px_x, px_y + m_charHeightPx - m_charShiftPx, text);
+	static const int Cols = 250;
+	static const int Rows = 80;
+	static const int Frames = 50;
+	// runs of 1 to 8 cells with different colors and attributes
+	QVector<core::term::ScreenCell> cells(Cols * Rows);
+	uint seed = 1;
+	for(int i=0; i<cells.size(); ) {
+		seed = seed * 1103515245 + 12345;
+		int run = 1 + (seed >> 16) % 8;
+		core::term::ScreenCell::Color fg = (seed >> 20) % 8;
+		core::term::ScreenCell::Color bg = (seed >> 24) % 4;
+		core::term::ScreenCell::Attributes attrs = (seed >> 28) & (core::term::ScreenCell::AttrBright | core::term::ScreenCell::AttrUnderscore);
+		for(int j=0; j<run && i<cells.size(); j++, i++)
+			cells[i] = core::term::ScreenCell(QChar('!' + (i * 7 + j) % 94), fg, bg, attrs);
+	}
+	QImage image(Cols * m_charWidthPx, Rows * m_charHeightPx, QImage::Format_RGB32);
+	bool use_glyph_atlas = m_useGlyphAtlas;
+	for(int pass=0; pass<2; pass++) {
+		m_useGlyphAtlas = (pass == 0);
+		QElapsedTimer tm;
+		tm.start();
+		for(int frame=0; frame<Frames; frame++) {
+			QPainter painter(&image);
+			painter.setFont(m_font);
+			for(int y=0; y<Rows; y++) {
+				core::term::ScreenLineView line(cells.constData() + y * Cols, Cols);
+				for(int x=0; x<Cols; ) {
+					int n = line.runLength(x);
+					paintText(&painter, QPoint(x, y), runText(line, x, n), line.at(x));
+					x += n;
+				}
+			}
+		}
+		qint64 msec = qMax(tm.elapsed(), Q_INT64_C(1));
+		LOGDEB() << (m_useGlyphAtlas? "glyph atlas:": "drawText:") << Cols << "x" << Rows << "screen"
+				 << Frames << "frames in" << msec << "ms," << (Frames * 1000.0 / msec) << "frames/s";
+	}
+	m_useGlyphAtlas = use_glyph_atlas;
 }
 
-QPen TerminalWidget::penForCell(const core::term::ScreenCell &cell)
+const QString& TerminalWidget::runText(const core::term::ScreenLineView &line, int ix, int n)
 {
-	bool reverse = cell.attributes() & core::term::ScreenCell::AttrReverse;
-	QColor color = m_palete.getColor(reverse? cell.bgColor(): cell.fgColor(), cell.attributes() & core::term::ScreenCell::AttrBright);
-	//LOGDEB() << Q_FUNC_INFO << color.name();
-	//color = m_palete.getColor(7, false);
-	return QPen(color);
+	// reserved buffer is reused, no allocation in paint path unless a line is longer than reserved capacity
+	m_textBuffer.resize(n);
+	line.copyLetters(ix, n, m_textBuffer.data());
+	return m_textBuffer;
 }
 
-QBrush TerminalWidget::brushForCell(const core::term::ScreenCell &cell)
+void TerminalWidget::paintText(QPainter *painter, const QPoint &term_pos, const QString &text, const core::term::ScreenCell &text_attrs)
 {
-	bool reverse = cell.attributes() & core::term::ScreenCell::AttrReverse;
-	QColor color = m_palete.getColor(reverse? cell.fgColor(): cell.bgColor(), false);
-	//LOGDEB() << Q_FUNC_INFO << color.name();
-	//color = m_palete.getColor(0, false);
-	return QBrush(color);
+	int px_x = term_pos.x() * m_charWidthPx - m_horizontalScrollPx;
+	int px_y = term_pos.y() * m_charHeightPx;
+	//LOGDEB() << term_pos.x() << term_pos.y() << text;
+	QRect r(px_x, px_y, text.length() * m_charWidthPx, m_charHeightPx);
+	// one table lookup for all colors of run
+	int style_key = Palette::styleKey(text_attrs);
+	painter->fillRect(r, m_palete.brush(style_key));
+	if(m_useGlyphAtlas) {
+		bool underline = text_attrs.attributes() & core::term::ScreenCell::AttrUnderscore;
+		m_glyphAtlas.drawText(painter, px_x, px_y, text, m_palete.fgColor(style_key), underline);
+	}
+	else {
+		painter->setPen(m_palete.pen(style_key));
+		painter->drawText(px_x, px_y + m_charHeightPx - m_charShiftPx, text);
+	}
 }
 
 void TerminalWidget::resizeEvent(QResizeEvent *ev)
@@ -182,20 +332,26 @@ void TerminalWidget::resizeEvent(QResizeEvent *ev)
 
 void TerminalWidget::setupGeometry()
 {
-	core::term::ScreenBuffer *screen_buffer = m_terminal->screenBuffer();
-	QSize old_size = screen_buffer->terminalSize();
+	QSize old_size = m_terminal->terminalSize();
 	QSize sz = geometry().size();
 	QSize new_size(sz.width() / m_charWidthPx, sz.height() / m_charHeightPx);
 	if(old_size != new_size) {
-		screen_buffer->setTerminalSize(new_size);
+		m_terminal->setTerminalSize(new_size);
 	}
 }
 
 void TerminalWidget::keyPressEvent(QKeyEvent *ev)
 {
 	//LOGDEB() << __FUNCTION__ << ev->text() << ev->text().toLatin1().toHex();
+	QElapsedTimer key_timer;
+	key_timer.start();
 	bool is_accepted = true;
 	core::term::SlavePtyProcess *pty = m_terminal->slavePtyProcess();
+	if(ev->key() == Qt::Key_Insert && (ev->modifiers() & Qt::ShiftModifier)) {
+		pasteClipboard();
+		ev->accept();
+		return;
+	}
 	switch(ev->key()) {
 		//case Qt::Key_CapsLock:
 		//case Qt::Key_Shift:
@@ -238,15 +394,49 @@ void TerminalWidget::keyPressEvent(QKeyEvent *ev)
 	if(is_accepted) {
 		ev->accept();
 		resetHistoryLinesOffset();
+		if(m_keyLatencyProbeTimer) {
+			m_maxKeyWriteNsecs = qMax(m_maxKeyWriteNsecs, key_timer.nsecsElapsed());
+			m_keyCount++;
+			if(pty->bytesToWrite() > 0)
+				m_queuedKeyCount++;
+		}
 	}
 }
 
+void TerminalWidget::probeKeyLatency()
+{
+	// timer fires late by the time GUI thread was busy, a key pressed meanwhile waited as long
+	qint64 delay = m_keyLatencyProbeTime.nsecsElapsed() - KeyLatencyProbeIntervalMs * Q_INT64_C(1000000);
+	m_keyLatencyProbeTime.start();
+	m_maxEventLoopDelayNsecs = qMax(m_maxEventLoopDelayNsecs, delay);
+	if(m_keyLatencyReportTime.elapsed() < 1000)
+		return;
+	LOGDEB() << "key latency: event loop delay max" << (m_maxEventLoopDelayNsecs / 1e6) << "ms,"
+			 << m_keyCount << "keys, key press to PTY write max" << (m_maxKeyWriteNsecs / 1e6) << "ms,"
+			 << m_queuedKeyCount << "keys queued behind PTY";
+	m_maxEventLoopDelayNsecs = 0;
+	m_maxKeyWriteNsecs = 0;
+	m_keyCount = 0;
+	m_queuedKeyCount = 0;
+	m_keyLatencyReportTime.start();
+}
+
 qint64 TerminalWidget::sendKey(const char *sequence, int length)
 {
 	core::term::SlavePtyProcess *pty = m_terminal->slavePtyProcess();
 	return pty->write(sequence, length);
 }
 
+void TerminalWidget::pasteClipboard()
+{
+	QString text = QApplication::clipboard()->text();
+	if(text.isEmpty())
+		return;
+	if(!m_terminal->slavePtyProcess()->paste(text.toUtf8()))
+		LOGWARN() << "paste of" << text.length() << "characters refused, too much data is waiting for terminal";
+	resetHistoryLinesOffset();
+}
+
 void TerminalWidget::scrollBy(int x_pixels, int y_lines)
 {
 	int old_x = m_horizontalScrollPx;
@@ -254,17 +444,23 @@ void TerminalWidget::scrollBy(int x_pixels, int y_lines)
 	m_horizontalScrollPx -= x_pixels;
 	if(m_horizontalScrollPx < 0) m_horizontalScrollPx = 0;
 	addHistoryLinesOffset(y_lines);
-	if(m_historyLinesOffset != old_ofset || old_x != m_horizontalScrollPx) {
-		invalidateAll();
-	}
+	scrollView(old_x, old_ofset);
+}
+
+void TerminalWidget::scrollView(int old_horizontal_scroll_px, int old_history_lines_offset)
+{
+	// snapshot has whole lines, horizontal scroll needs no new content
+	blit(old_horizontal_scroll_px - m_horizontalScrollPx, 0);
+	// history lines come with the next snapshot, flushFrame() moves painted pixels then
+	if(m_historyLinesOffset != old_history_lines_offset)
+		m_terminal->setViewOffset(m_historyLinesOffset);
 }
 
 void TerminalWidget::addHistoryLinesOffset(int offset)
 {
 	m_historyLinesOffset += offset;
 	// anti wind-up
-	core::term::ScreenBuffer *screen_buffer = m_terminal->screenBuffer();
-	int start_ix = screen_buffer->firstVisibleLineIndex() - m_historyLinesOffset;
+	int start_ix = m_terminal->snapshot().historyCount - m_historyLinesOffset;
 	if(start_ix < 0) {
 		m_historyLinesOffset += start_ix;
 	}
@@ -275,9 +471,11 @@ void TerminalWidget::addHistoryLinesOffset(int offset)
 
 void TerminalWidget::resetHistoryLinesOffset()
 {
+	int old_x = m_horizontalScrollPx;
+	int old_ofset = m_historyLinesOffset;
 	m_horizontalScrollPx = 0;
 	m_historyLinesOffset = 0;
-	invalidateAll();
+	scrollView(old_x, old_ofset);
 }
 
 void TerminalWidget::wheelEvent(QWheelEvent *ev)
@@ -316,8 +514,7 @@ bool TerminalWidget::event(QEvent *ev)
 			double velocity = delta_px / (double)tm_ms;
 			LOGDEB() << "delta;" << delta_px << "time:" << tm_ms << "vel:" << velocity;
 			*/
-			core::term::ScreenBuffer *screen_buffer = m_terminal->screenBuffer();
-			int lines = delta_y_px * screen_buffer->terminalSize().height() / size().height();
+			int lines = delta_y_px * m_terminal->terminalSize().height() / size().height();
 			static const int HORIZONTAL_SCROLL_TRESHOLD = 50;
 			if(lines != 0 || delta_x_px > HORIZONTAL_SCROLL_TRESHOLD || delta_x_px < -HORIZONTAL_SCROLL_TRESHOLD) {
 				//LOGDEB() << "MouseMove" << "delta:" << delta_px << "lines:" << lines;
@@ -341,8 +538,7 @@ bool TerminalWidget::gestureEvent(QGestureEvent *ev)
 		ret = true;
 		QSwipeGesture *swipe_gesture = static_cast<QSwipeGesture *>(swipe);
 		if (swipe_gesture->state() == Qt::GestureFinished) {
-			core::term::ScreenBuffer *screen_buffer = m_terminal->screenBuffer();
-			int delta = screen_buffer->terminalSize().height();
+			int delta = m_terminal->terminalSize().height();
 			if (swipe_gesture->verticalDirection() == QSwipeGesture::Up) delta = -delta;
 			scrollBy(0, delta);
 		}
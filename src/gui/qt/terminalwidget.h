@@ -2,6 +2,7 @@
 #define TERMINALWIDGET_H
 
 #include "palette.h"
+#include "glyphatlas.h"
 
 #include <QWidget>
 #include <QFont>
@@ -11,11 +12,13 @@
 namespace core {
 namespace term {
 class ScreenCell;
+class ScreenLineView;
 class Terminal;
 }
 }
 
 class QGestureEvent;
+class QTimer;
 
 namespace gui {
 namespace qt {
@@ -23,8 +26,13 @@ namespace qt {
 class TerminalWidget : public QWidget
 {
 	Q_OBJECT
+public:
+	static const int DefaultFrameRate = 60;
 public:
 	explicit TerminalWidget(QWidget *parent = 0);
+
+	/// max repaints per second for new widgets, 0 means not limited
+	static void setDefaultFrameRate(int hz);
 public:
 	void setTerminal(core::term::Terminal *t);
 
@@ -34,6 +42,8 @@ public:
 	void pushKeyRight() {sendKey("\x1bOC", 3); resetHistoryLinesOffset();}
 	void pushKeyLeft() {sendKey("\x1bOD", 3); resetHistoryLinesOffset();}
 	void pushKeyBackspace() {sendKey("\b", 1); resetHistoryLinesOffset();}
+	/// clipboard text is queued behind typed keys, so typing is not delayed by long paste
+	void pasteClipboard();
 protected:
 	void paintEvent(QPaintEvent *ev) Q_DECL_OVERRIDE;
 	void resizeEvent(QResizeEvent *ev) Q_DECL_OVERRIDE;
@@ -48,18 +58,28 @@ private:
 private:
 	void setupGeometry();
 	void setupFont(int point_size);
-	QPen penForCell(const core::term::ScreenCell &cell);
-	QBrush brushForCell(const core::term::ScreenCell &cell);
 	void paintText(QPainter *painter, const QPoint &term_pos, const QString &text, const core::term::ScreenCell &text_attrs);
+	/// paint 250x80 screen of colored text with glyph atlas and with QPainter::drawText, log frames per second
+	void runPaintBenchmark();
+	/// letters of cells <ix, ix + n) of line in reused text buffer
+	const QString& runText(const core::term::ScreenLineView &line, int ix, int n);
 
 	void scrollBy(int x_pixels, int y_lines);
+	/// move painted pixels after horizontal scroll, vertical scroll is applied when snapshot with new offset comes
+	void scrollView(int old_horizontal_scroll_px, int old_history_lines_offset);
+	void blit(int dx, int dy);
 	void addHistoryLinesOffset(int offset);
 	void resetHistoryLinesOffset();
 
-	Q_SLOT void invalidateRegion(const QRect &dirty_rect);
+	/// snapshots coming faster than frame rate are skipped, their damage is merged by terminal
+	Q_SLOT void scheduleFrame();
+	/// take the latest snapshot, move painted pixels by its scroll and invalidate its damage
+	Q_SLOT void flushFrame();
 	void invalidateAll();
 
 	Q_SLOT void updateFocus(bool activate);
+	/// measure delay of GUI event loop, a key press waits for it before keyPressEvent()
+	Q_SLOT void probeKeyLatency();
 
 	void sendKeyTab() {sendKey("\t", 1);}
 	void sendKeyUp() {sendKey("\x1bOA", 3);}
@@ -79,6 +99,32 @@ private:
 	QPoint m_swipeStartPosition;
 	//QElapsedTimer m_swipeSpeedTimer;
 	int m_horizontalScrollPx;
+	// text of painted run, reused between paint events
+	enum {TextBufferCapacity = 512};
+	QString m_textBuffer;
+	GlyphAtlas m_glyphAtlas;
+	bool m_useGlyphAtlas;
+
+	static int s_defaultFrameRate;
+	int m_frameIntervalMs;
+	QTimer *m_frameTimer;
+	QElapsedTimer m_lastFrameTime;
+	// scroll state of snapshot taken by the last frame, painted pixels correspond to it
+	qint64 m_frameScrolledLines;
+	int m_frameHistoryOffset;
+	QPoint m_frameCursorPosition;
+	QSize m_frameTerminalSize;
+
+	// BBTERM_KEY_LATENCY=1 logs key press latency every second, 0 if not measured
+	enum {KeyLatencyProbeIntervalMs = 5};
+	QTimer *m_keyLatencyProbeTimer;
+	QElapsedTimer m_keyLatencyProbeTime;
+	QElapsedTimer m_keyLatencyReportTime;
+	qint64 m_maxEventLoopDelayNsecs;
+	qint64 m_maxKeyWriteNsecs;
+	int m_keyCount;
+	// keys not written to PTY by keyPressEvent(), they wait in write queue
+	int m_queuedKeyCount;
 };
 
 }
@@ -1,5 +1,8 @@
 #include "gui/qt/mainwindow.h"
+#include "gui/qt/terminalwidget.h"
 #include "core/term/slaveptyprocess.h"
+#include "core/term/screenbuffer.h"
+#include "core/term/ptytrace.h"
 
 #include <QApplication>
 #include <QDebug>
@@ -25,6 +28,10 @@
 int main(int argc, char *argv[])
 {
 	QString shell_path;
+	int scrollback_depth = 0;
+	QString scrollback_file;
+	int frame_rate = -1;
+	QString trace_file;
 	for(int i=1; i<argc; i++) {
 		QString arg = argv[i];
 		if(arg == "--shell") {
@@ -33,6 +40,61 @@ int main(int argc, char *argv[])
 				shell_path = argv[i];
 			}
 		}
+		else if(arg == "--scrollback") {
+			i++;
+			if(i < argc) {
+				scrollback_depth = QString(argv[i]).toInt();
+			}
+		}
+		else if(arg == "--scrollback-file") {
+			i++;
+			if(i < argc) {
+				scrollback_file = argv[i];
+			}
+		}
+		else if(arg == "--frame-rate") {
+			i++;
+			if(i < argc) {
+				frame_rate = QString(argv[i]).toInt();
+			}
+		}
+		else if(arg == "--trace") {
+			i++;
+			if(i < argc) {
+				trace_file = argv[i];
+			}
+		}
+	}
+	if(scrollback_depth <= 0) {
+		// check BBTERM_SCROLLBACK env var
+		scrollback_depth = QString(::getenv("BBTERM_SCROLLBACK")).toInt();
+	}
+	if(scrollback_depth > 0) {
+		core::term::ScreenBuffer::setDefaultScrollbackDepth(scrollback_depth);
+	}
+	if(scrollback_file.isEmpty()) {
+		// check BBTERM_SCROLLBACK_FILE env var
+		scrollback_file = ::getenv("BBTERM_SCROLLBACK_FILE");
+	}
+	if(!scrollback_file.isEmpty()) {
+		core::term::ScreenBuffer::setDefaultScrollbackFile(scrollback_file);
+	}
+	if(frame_rate < 0) {
+		// check BBTERM_FRAME_RATE env var
+		QByteArray env_frame_rate = qgetenv("BBTERM_FRAME_RATE");
+		if(!env_frame_rate.isEmpty())
+			frame_rate = env_frame_rate.toInt();
+	}
+	if(frame_rate >= 0) {
+		gui::qt::TerminalWidget::setDefaultFrameRate(frame_rate);
+	}
+	if(trace_file.isEmpty()) {
+		// check BBTERM_TRACE env var
+		trace_file = ::getenv("BBTERM_TRACE");
+	}
+	if(!trace_file.isEmpty()) {
+		core::term::PtyTrace::setFile(trace_file);
+		core::term::PtyTrace::setEnabled(true);
 	}
 	if(shell_path.isEmpty()) {
 		// check SHELL env var
@@ -81,8 +143,11 @@ int main(int argc, char *argv[])
 	::fcntl(fd, F_SETFL, flags | O_NONBLOCK);
 
 	QApplication a(argc, argv);
+	// kill -USR1 switches PTY tracing on and off
+	core::term::PtyTrace::installSignalHandler();
 	core::term::SlavePtyProcess slave_pty_process(fd, pid);
-	if(!slave_pty_process.open(QIODevice::ReadWrite)) {
+	// unbuffered, Terminal reads directly to its own input buffer
+	if(!slave_pty_process.open(QIODevice::ReadWrite | QIODevice::Unbuffered)) {
 		qWarning() << "cannot open master fd";
 		return 1;
 	}
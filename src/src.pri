@@ -7,5 +7,8 @@ FORMS += \
 
 INCLUDEPATH += $$PWD
 
+# scrollback file can grow above 2GB on 32 bit targets
+DEFINES += _FILE_OFFSET_BITS=64
+
 include(core/core.pri)
 include(gui/gui.pri)
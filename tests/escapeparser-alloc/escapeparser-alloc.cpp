@@ -0,0 +1,135 @@
+// Check that parsing terminal input does not touch the heap.
+//
+// A corpus of printable ASCII, UTF-8, CSI (SGR with extended colors, cursor moves,
+// erase, insert/delete, scrolling region), ESC and OSC sequences is fed through
+// ScreenBuffer and its EscapeParser. After warm-up rounds, which let reserved buffers
+// reach their final size, no malloc(), calloc() or realloc() may be called,
+// neither for the whole corpus nor for the corpus cut to small pieces,
+// which splits sequences between process() calls.
+//
+// Allocations are counted by replacing malloc() of glibc, so Qt containers
+// allocating through malloc() are counted as well as operator new.
+
+#include <core/term/screenbuffer.h>
+#include <core/term/slaveptyprocess.h>
+
+#include <QCoreApplication>
+#include <QByteArray>
+#include <QSize>
+
+#include <stdio.h>
+#include <unistd.h>
+
+#ifdef Q_OS_QNX
+#include <unix.h>
+#else
+#include <pty.h>
+#endif
+
+#ifdef __GLIBC__
+#define COUNT_ALLOCATIONS
+#endif
+
+namespace {
+
+bool s_counting = false;
+long s_allocations = 0;
+
+const int WarmUpRounds = 3;
+const int Rounds = 100;
+
+QByteArray makeCorpus()
+{
+	QByteArray ret;
+	// whole screen is rewritten from home position, nothing scrolls to history
+	ret += "\033[H\033[2J";
+	ret += "plain ASCII line to fill some cells\r\n";
+	ret += "\033[1;31;44mbright red on blue\033[0m \033[4;7munderscore reverse\033[39;49m\r\n";
+	ret += "\033[38;5;196m256 colors\033[48:2::10:20:30m rgb colors\033[0m\r\n";
+	ret += "\xc5\xbelu\xc5\xa5ou\xc4\x8dk\xc3\xbd k\xc5\xaf\xc5\x88 \xe2\x82\xac \xf0\x9f\x98\x80\r\n";
+	ret += "\033[10;20Hmoved\033[2A\033[3Cup right\033[B\033[5Ddown left\r\n";
+	ret += "erase\033[K\033[1K\033[2K\033[5X\r\n";
+	ret += "insert\033[3D\033[2@delete\033[2P repeat\033[5b\r\n";
+	ret += "\0337\033[3;12r\033[5;1H\033[2L\033[M\033D\033M\033E\033[S\033[T\033[r\0338";
+	ret += "\033]0;window title\007\033]2;another title\033\\";
+	ret += "\033[?1049h\033[Halternate screen\033[?1049l";
+	ret += "\033[?25l\033[?25h\ttab\x08\x08 backspace\r\n";
+	return ret;
+}
+
+void feed(core::term::ScreenBuffer *screen, const QByteArray &corpus, int chunk_size)
+{
+	for(int pos=0; pos<corpus.size(); pos += chunk_size)
+		screen->processInput(corpus.constData() + pos, qMin(chunk_size, corpus.size() - pos));
+}
+
+}
+
+#ifdef COUNT_ALLOCATIONS
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *p, size_t size);
+
+void *malloc(size_t size)
+{
+	if(s_counting)
+		s_allocations++;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+	if(s_counting)
+		s_allocations++;
+	return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, size_t size)
+{
+	if(s_counting)
+		s_allocations++;
+	return __libc_realloc(p, size);
+}
+}
+#endif
+
+int main(int argc, char *argv[])
+{
+#ifndef COUNT_ALLOCATIONS
+	Q_UNUSED(argc);
+	Q_UNUSED(argv);
+	printf("SKIP: allocations can be counted with glibc only\n");
+	return 0;
+#else
+	QCoreApplication app(argc, argv);
+	int master_fd, slave_fd;
+	if(::openpty(&master_fd, &slave_fd, 0, 0, 0) != 0) {
+		perror("openpty");
+		return 1;
+	}
+	// SIGWINCH sent on resize is ignored by default
+	core::term::SlavePtyProcess pty(master_fd, ::getpid());
+	core::term::ScreenBuffer screen(&pty);
+	screen.setTerminalSize(QSize(80, 25));
+	const QByteArray corpus = makeCorpus();
+	const int chunk_sizes[] = {corpus.size(), 7, 1};
+	int failed = 0;
+	for(size_t i=0; i<sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); i++) {
+		int chunk_size = chunk_sizes[i];
+		for(int round=0; round<WarmUpRounds; round++)
+			feed(&screen, corpus, chunk_size);
+		s_allocations = 0;
+		s_counting = true;
+		for(int round=0; round<Rounds; round++)
+			feed(&screen, corpus, chunk_size);
+		s_counting = false;
+		printf("%s: chunk %d bytes, %d rounds of %d bytes, %ld allocations\n",
+			   (s_allocations == 0)? "PASS": "FAIL", chunk_size, Rounds, corpus.size(), s_allocations);
+		if(s_allocations != 0)
+			failed++;
+	}
+	::close(slave_fd);
+	return (failed == 0)? 0: 1;
+#endif
+}
@@ -0,0 +1,28 @@
+# Parse path allocation test, run by 'make check'.
+# Links core sources of bbterm, it runs on the host with glibc.
+
+QT       += core gui
+
+greaterThan(QT_MAJOR_VERSION, 4) {
+	QT += widgets
+}
+else {
+	DEFINES += Q_DECL_OVERRIDE=
+}
+
+TEMPLATE = app
+TARGET = escapeparser-alloc
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+!qnx {
+LIBS += \
+  -lutil \
+}
+
+INCLUDEPATH += ../../src
+
+include(../../src/core/core.pri)
+
+SOURCES += \
+	escapeparser-alloc.cpp
@@ -0,0 +1,208 @@
+// Check that the view never gets a half drawn synchronized update (DECSET 2026).
+//
+// Frames are written to PTY and replayed by TerminalEmulator with PTY read on its own
+// thread disabled, so all input written before the event loop runs is parsed in one slice.
+// Every frame fills the screen with '#' several times and then with its own letter.
+// The first replay contains frame A and the beginning of frame B, it is split to two parse
+// chunks and it ends inside of an update, the second one contains the rest of frame B.
+// Every snapshot published for the view must show a whole frame: blank screen,
+// or screen full of one letter, never '#' and never letters of two frames.
+
+#include <core/term/terminalemulator.h>
+#include <core/term/slaveptyprocess.h>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QByteArray>
+#include <QSize>
+
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+
+#ifdef Q_OS_QNX
+#include <unix.h>
+#else
+#include <pty.h>
+#endif
+
+namespace {
+
+const int Columns = 80;
+const int Rows = 25;
+// '#' passes of one frame, frame A with the beginning of frame B (about 11kB) is longer
+// than TerminalEmulator parse chunk and it still fits to PTY buffer, so it is written at once
+const int ScratchPasses = 2;
+// event loop runs at least this long after input is written,
+// it is well below ScreenBuffer::SynchronizedUpdateTimeoutMs
+const int PumpMs = 20;
+
+QByteArray fillScreen(char c)
+{
+	QByteArray ret;
+	for(int y=0; y<Rows; y++) {
+		ret += "\033[" + QByteArray::number(y + 1) + ";1H";
+		ret += QByteArray(Columns, c);
+	}
+	return ret;
+}
+
+QByteArray beginFrame()
+{
+	QByteArray ret = "\033[?2026h";
+	for(int i=0; i<ScratchPasses; i++)
+		ret += fillScreen('#');
+	return ret;
+}
+
+QByteArray endFrame(char c)
+{
+	return fillScreen(c) + "\033[?2026l";
+}
+
+bool writeAll(int fd, const QByteArray &data)
+{
+	for(int pos=0; pos<data.size(); ) {
+		ssize_t n = ::write(fd, data.constData() + pos, data.size() - pos);
+		if(n < 0) {
+			perror("write");
+			return false;
+		}
+		pos += n;
+	}
+	return true;
+}
+
+}
+
+class SnapshotChecker : public QObject
+{
+	Q_OBJECT
+public:
+	explicit SnapshotChecker(core::term::TerminalEmulator *emulator)
+	: m_emulator(emulator), m_snapshotCount(0), m_tornCount(0), m_lastLetter(0) {}
+
+	int snapshotCount() const {return m_snapshotCount;}
+	int tornCount() const {return m_tornCount;}
+	/// letter of the last snapshot, 0 for blank screen
+	char lastLetter() const {return m_lastLetter;}
+public slots:
+	void onSnapshotReady()
+	{
+		// emulator runs on this thread, so every published snapshot is taken
+		if(!m_emulator->snapshots().update())
+			return;
+		const core::term::ScreenSnapshot &snapshot = m_emulator->snapshots().front();
+		m_snapshotCount++;
+		char letter = 0;
+		bool torn = false;
+		for(int y=0; y<snapshot.rowCount(); y++) {
+			core::term::ScreenLineView line = snapshot.lineView(y);
+			if(line.isEmpty())
+				continue;
+			if(letter == 0)
+				letter = line.at(0).letter().toLatin1();
+			if(letter == '#' || line.length() != Columns)
+				torn = true;
+			for(int x=0; x<line.length(); x++) {
+				if(line.at(x).letter().toLatin1() != letter)
+					torn = true;
+			}
+		}
+		// frame is drawn over the whole screen, a blank row next to a full one is torn too
+		if(letter != 0) {
+			for(int y=0; y<snapshot.rowCount(); y++) {
+				if(snapshot.lineView(y).isEmpty())
+					torn = true;
+			}
+		}
+		if(torn) {
+			m_tornCount++;
+			printf("torn snapshot %d:\n", m_snapshotCount);
+			for(int y=0; y<snapshot.rowCount(); y++) {
+				core::term::ScreenLineView line = snapshot.lineView(y);
+				QByteArray row;
+				for(int x=0; x<line.length(); x++)
+					row += line.at(x).letter().toLatin1();
+				printf("  |%s|\n", row.constData());
+			}
+		}
+		m_lastLetter = letter;
+	}
+private:
+	core::term::TerminalEmulator *m_emulator;
+	int m_snapshotCount;
+	int m_tornCount;
+	char m_lastLetter;
+};
+
+namespace {
+
+/// run event loop until written input is parsed
+void pump(int master_fd)
+{
+	QElapsedTimer tm;
+	tm.start();
+	while(true) {
+		QCoreApplication::processEvents();
+		struct pollfd pfd;
+		pfd.fd = master_fd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		if(tm.elapsed() >= PumpMs && ::poll(&pfd, 1, 0) == 0)
+			break;
+	}
+}
+
+bool check(const char *step, const SnapshotChecker &checker, char expected_letter)
+{
+	bool ok = (checker.tornCount() == 0 && checker.lastLetter() == expected_letter);
+	printf("%s: %s, %d snapshots, %d torn, last one shows '%c'\n",
+		   ok? "PASS": "FAIL", step, checker.snapshotCount(), checker.tornCount(),
+		   checker.lastLetter()? checker.lastLetter(): ' ');
+	return ok;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	// input written before the event loop runs is parsed in one slice
+	qputenv("BBTERM_PTY_THREAD", "0");
+	int master_fd, slave_fd;
+	if(::openpty(&master_fd, &slave_fd, 0, 0, 0) != 0) {
+		perror("openpty");
+		return 1;
+	}
+	int flags = ::fcntl(master_fd, F_GETFL, 0);
+	::fcntl(master_fd, F_SETFL, flags | O_NONBLOCK);
+	// SIGWINCH sent on resize is ignored by default
+	core::term::SlavePtyProcess pty(master_fd, ::getpid());
+	core::term::TerminalEmulator emulator(&pty);
+	SnapshotChecker checker(&emulator);
+	QObject::connect(&emulator, SIGNAL(snapshotReady()), &checker, SLOT(onSnapshotReady()));
+	emulator.setTerminalSize(QSize(Columns, Rows));
+
+	int failed = 0;
+	// the whole frame A and the beginning of frame B in one slice
+	if(!writeAll(slave_fd, beginFrame() + endFrame('A') + beginFrame()))
+		return 1;
+	pump(master_fd);
+	if(!check("frame A, frame B open", checker, 'A'))
+		failed++;
+	// view scrolled while frame B is open must not get it either
+	emulator.setViewOffset(0);
+	if(!check("view offset set, frame B open", checker, 'A'))
+		failed++;
+	if(!writeAll(slave_fd, endFrame('B')))
+		return 1;
+	pump(master_fd);
+	if(!check("frame B finished", checker, 'B'))
+		failed++;
+	::close(slave_fd);
+	return (failed == 0)? 0: 1;
+}
+
+#include "synchronized-update.moc"
@@ -0,0 +1,28 @@
+# Synchronized update (DECSET 2026) replay test, run by 'make check'.
+# Links core sources of bbterm, it needs a PTY of the host.
+
+QT       += core gui
+
+greaterThan(QT_MAJOR_VERSION, 4) {
+	QT += widgets
+}
+else {
+	DEFINES += Q_DECL_OVERRIDE=
+}
+
+TEMPLATE = app
+TARGET = synchronized-update
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+!qnx {
+LIBS += \
+  -lutil \
+}
+
+INCLUDEPATH += ../../src
+
+include(../../src/core/core.pri)
+
+SOURCES += \
+	synchronized-update.cpp
@@ -0,0 +1,7 @@
+# Tests run on the host by 'make check' of bbterm.pro, every test is an app with CONFIG += testcase.
+
+TEMPLATE = subdirs
+
+SUBDIRS += \
+	escapeparser-alloc \
+	synchronized-update
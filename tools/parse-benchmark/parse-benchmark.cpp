@@ -0,0 +1,472 @@
+// Parser throughput benchmark, feeds a log through ScreenBuffer the way terminal does,
+// without GUI and without PTY reading, and prints MB/s and the longest processInput() call.
+//
+// usage: parse-benchmark [-s MB] [-c CHUNK] [-g COLSxROWS] [-m] [-p] [-t TRACE] [-v] [FILE]
+//   FILE  log to feed (it is repeated up to -s MB), default is generated build log
+//         with colored words and UTF-8 text
+//   -s  megabytes to feed, default 64
+//   -c  bytes passed to one processInput() call, default 8192 like TerminalEmulator
+//   -g  terminal size, default 80x25
+//   -m  instead of throughput print heap used by the screen, filled with colored text
+//       (run with -g 200x60), bytes and allocations are counted by replacing glibc malloc()
+//   -p  instead of throughput count allocations per frame of the paint data path,
+//       the screen is walked by runs of cells like TerminalWidget::paintEvent() does,
+//       QPainter is left out, it is the same before and after
+//   -t  instead of throughput replay PTY trace recorded by BBTERM_TRACE (run with -g of the traced terminal),
+//       every recorded read is one processInput() call, prints how many of them changed the screen
+//       and how many frames TerminalWidget paints for them at its default 60 frames/s pacing
+//   -v  keep debug log of terminal, it is discarded by default
+
+#include <core/term/screenbuffer.h>
+#include <core/term/slaveptyprocess.h>
+#include <core/term/ptytraceformat.h>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QByteArray>
+#include <QString>
+#include <QFile>
+#include <QSize>
+#include <QRect>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef Q_OS_QNX
+#include <unix.h>
+#else
+#include <pty.h>
+#endif
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#define COUNT_ALLOCATIONS
+#endif
+
+// set by every dirtyRegion() of screen buffer
+class DamageCounter : public QObject
+{
+	Q_OBJECT
+public:
+	DamageCounter() : isDamaged(false) {}
+public slots:
+	void onDirtyRegion(const QRect &rect) {Q_UNUSED(rect); isDamaged = true;}
+public:
+	bool isDamaged;
+};
+
+namespace {
+
+const int GeneratedLogSize = 1024 * 1024;
+const int PaintFrames = 100;
+// TerminalWidget::DefaultFrameRate
+const int FrameIntervalMs = 1000 / 60;
+
+uint s_seed = 1;
+
+// heap use while s_counting is set, frees of older blocks are subtracted too
+bool s_counting = false;
+qint64 s_allocations = 0;
+qint64 s_heapBytes = 0;
+// run text goes here, so the walk cannot be optimized out
+uint s_paintChecksum = 0;
+
+uint nextRandom(uint range)
+{
+	s_seed = s_seed * 1103515245 + 12345;
+	return (s_seed >> 16) % range;
+}
+
+// lines shorter than 80 columns, escape sequences known to every parser version
+QByteArray generateLog()
+{
+	static const char *const words[] = {
+		"src/core/term/screenbuffer.cpp", "warning:", "unused", "variable", "in", "function",
+		"compiling", "linking", "objects/", "make[2]:", "Leaving", "directory", "-O2", "-Wall",
+		"\xc5\xbelu\xc5\xa5ou\xc4\x8dk\xc3\xbd", "k\xc5\xaf\xc5\x88", "\xe2\x82\xac", "na\xc3\xafve",
+	};
+	static const int word_count = sizeof(words) / sizeof(words[0]);
+	QByteArray ret;
+	ret.reserve(GeneratedLogSize + 128);
+	while(ret.size() < GeneratedLogSize) {
+		int line_len = 0;
+		int target_len = 20 + nextRandom(50);
+		while(line_len < target_len) {
+			const char *w = words[nextRandom(word_count)];
+			if(nextRandom(5) == 0) {
+				// ls --color and compiler diagnostics style
+				char sgr[16];
+				::snprintf(sgr, sizeof(sgr), "\033[%u;%um", nextRandom(2), 31 + nextRandom(7));
+				ret += sgr;
+				ret += w;
+				ret += "\033[0m";
+			}
+			else {
+				ret += w;
+			}
+			ret += ' ';
+			line_len += ::strlen(w) + 1;
+		}
+		ret += "\r\n";
+	}
+	return ret;
+}
+
+// rows of runs of 8 cells with different colors, the last cell is left out so the screen does not scroll
+QByteArray generateScreen(const QSize &cols_rows)
+{
+	QByteArray ret;
+	for(int y=0; y<cols_rows.height(); y++) {
+		if(y > 0)
+			ret += "\r\n";
+		for(int x=0; x<cols_rows.width() - 1; x++) {
+			if(x % 8 == 0) {
+				char sgr[16];
+				::snprintf(sgr, sizeof(sgr), "\033[%dm", 31 + (x / 8 + y) % 7);
+				ret += sgr;
+			}
+			ret += static_cast<char>('A' + (x + y) % 26);
+		}
+	}
+	ret += "\033[0m";
+	return ret;
+}
+
+void paintText(const QString &text)
+{
+	s_paintChecksum += text.length() + text.at(0).unicode();
+}
+
+// TerminalWidget::paintEvent() and runText()
+void paintFrame(core::term::ScreenBuffer *screen, QString *text_buffer)
+{
+	int start_line_ix = screen->firstVisibleLineIndex();
+	for(int i=start_line_ix; i<screen->rowCount(); i++) {
+		const core::term::ScreenLineView line = screen->lineView(i);
+		for(int x=0; x<line.length(); ) {
+			int n = line.runLength(x);
+			text_buffer->resize(n);
+			line.copyLetters(x, n, text_buffer->data());
+			paintText(*text_buffer);
+			x += n;
+		}
+	}
+}
+
+int replayTrace(core::term::ScreenBuffer *screen, const char *file_name)
+{
+	QFile f(QString::fromLocal8Bit(file_name));
+	if(!f.open(QIODevice::ReadOnly)) {
+		::fprintf(stderr, "cannot open %s\n", file_name);
+		return 1;
+	}
+	QByteArray data = f.readAll();
+	PtyTraceHeader header;
+	if(data.size() < static_cast<int>(sizeof(header))) {
+		::fprintf(stderr, "%s: not a PTY trace file\n", file_name);
+		return 1;
+	}
+	::memcpy(&header, data.constData(), sizeof(header));
+	if(::memcmp(header.magic, PTY_TRACE_MAGIC, sizeof(header.magic))
+			|| static_cast<quint64>(data.size()) < header.headerSize + header.capacity) {
+		::fprintf(stderr, "%s: not a PTY trace file or truncated\n", file_name);
+		return 1;
+	}
+	const char *ring = data.constData() + header.headerSize;
+
+	DamageCounter damage;
+	QObject::connect(screen, SIGNAL(dirtyRegion(QRect)), &damage, SLOT(onDirtyRegion(QRect)));
+	qint64 read_count = 0;
+	qint64 damaged_read_count = 0;
+	qint64 frame_count = 0;
+	// frame pacing of TerminalWidget::scheduleFrame() in trace time
+	bool is_frame_scheduled = false;
+	quint64 frame_nsecs = 0;
+	quint64 last_frame_nsecs = 0;
+	bool has_frame = false;
+	// same walk as tools/ptytrace-dump, wrapped ring starts with the oldest record
+	quint64 pos = header.wrapped? header.oldestPos: 0;
+	bool is_second_lap = !header.wrapped || pos < header.writePos;
+	while(true) {
+		if(is_second_lap && pos >= header.writePos)
+			break;
+		if(pos + sizeof(PtyTraceRecord) > header.capacity) {
+			pos = 0;
+			is_second_lap = true;
+			continue;
+		}
+		PtyTraceRecord rec;
+		::memcpy(&rec, ring + pos, sizeof(rec));
+		quint64 size = ptyTraceRecordSize(rec.length);
+		if(pos + size > header.capacity) {
+			::fprintf(stderr, "corrupted record at offset %llu\n", pos);
+			return 1;
+		}
+		if(rec.type == PtyTraceRead) {
+			if(is_frame_scheduled && rec.nsecs >= frame_nsecs) {
+				frame_count++;
+				last_frame_nsecs = frame_nsecs;
+				is_frame_scheduled = false;
+			}
+			damage.isDamaged = false;
+			screen->processInput(ring + pos + sizeof(PtyTraceRecord), rec.length);
+			read_count++;
+			if(damage.isDamaged) {
+				damaged_read_count++;
+				if(!is_frame_scheduled) {
+					is_frame_scheduled = true;
+					frame_nsecs = rec.nsecs;
+					if(has_frame)
+						frame_nsecs = qMax(frame_nsecs, last_frame_nsecs + FrameIntervalMs * Q_UINT64_C(1000000));
+					has_frame = true;
+				}
+			}
+		}
+		pos += size;
+	}
+	if(is_frame_scheduled)
+		frame_count++;
+	::printf("%s: %lld reads, %lld of them changed the screen, %lld frames at 60 frames/s\n",
+			 file_name, read_count, damaged_read_count, frame_count);
+	return 0;
+}
+
+void startCounting()
+{
+	s_allocations = 0;
+	s_heapBytes = 0;
+	s_counting = true;
+}
+
+void printHeapUse(const char *what, int cells)
+{
+	s_counting = false;
+	::printf("%s: %lld bytes in %lld allocations", what, s_heapBytes, s_allocations);
+	if(cells > 0)
+		::printf(", %.1f bytes per cell", static_cast<double>(s_heapBytes) / cells);
+	::printf("\n");
+}
+
+#if QT_VERSION >= 0x050000
+void discardDebugMessages(QtMsgType type, const QMessageLogContext &context, const QString &msg)
+{
+	Q_UNUSED(context);
+	if(type != QtDebugMsg)
+		::fprintf(stderr, "%s\n", qPrintable(msg));
+}
+#else
+void discardDebugMessages(QtMsgType type, const char *msg)
+{
+	if(type != QtDebugMsg)
+		::fprintf(stderr, "%s\n", msg);
+}
+#endif
+
+}
+
+#ifdef COUNT_ALLOCATIONS
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *p, size_t size);
+void __libc_free(void *p);
+
+void *malloc(size_t size)
+{
+	void *p = __libc_malloc(size);
+	if(s_counting && p) {
+		s_allocations++;
+		s_heapBytes += malloc_usable_size(p);
+	}
+	return p;
+}
+
+void *calloc(size_t n, size_t size)
+{
+	void *p = __libc_calloc(n, size);
+	if(s_counting && p) {
+		s_allocations++;
+		s_heapBytes += malloc_usable_size(p);
+	}
+	return p;
+}
+
+void *realloc(void *p, size_t size)
+{
+	if(s_counting && p)
+		s_heapBytes -= malloc_usable_size(p);
+	p = __libc_realloc(p, size);
+	if(s_counting && p) {
+		s_allocations++;
+		s_heapBytes += malloc_usable_size(p);
+	}
+	return p;
+}
+
+void free(void *p)
+{
+	if(s_counting && p)
+		s_heapBytes -= malloc_usable_size(p);
+	__libc_free(p);
+}
+}
+#endif
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	qint64 feed_size = 64 * 1024 * 1024;
+	int chunk_size = 8 * 1024;
+	QSize terminal_size(80, 25);
+	bool measure_memory = false;
+	bool measure_paint = false;
+	const char *trace_file_name = 0;
+	bool verbose = false;
+	const char *file_name = 0;
+	for(int i=1; i<argc; i++) {
+		if(!::strcmp(argv[i], "-s") && i + 1 < argc) {
+			feed_size = ::atoi(argv[++i]) * Q_INT64_C(1024 * 1024);
+		}
+		else if(!::strcmp(argv[i], "-c") && i + 1 < argc) {
+			chunk_size = ::atoi(argv[++i]);
+		}
+		else if(!::strcmp(argv[i], "-g") && i + 1 < argc) {
+			int cols = 0, rows = 0;
+			if(::sscanf(argv[++i], "%dx%d", &cols, &rows) == 2)
+				terminal_size = QSize(cols, rows);
+		}
+		else if(!::strcmp(argv[i], "-m")) {
+			measure_memory = true;
+		}
+		else if(!::strcmp(argv[i], "-p")) {
+			measure_paint = true;
+		}
+		else if(!::strcmp(argv[i], "-t") && i + 1 < argc) {
+			trace_file_name = argv[++i];
+		}
+		else if(!::strcmp(argv[i], "-v")) {
+			verbose = true;
+		}
+		else if(argv[i][0] != '-') {
+			file_name = argv[i];
+		}
+		else {
+			::fprintf(stderr, "usage: %s [-s MB] [-c CHUNK] [-g COLSxROWS] [-m] [-p] [-t TRACE] [-v] [FILE]\n", argv[0]);
+			return 1;
+		}
+	}
+	if(feed_size <= 0 || chunk_size <= 0 || terminal_size.isEmpty()) {
+		::fprintf(stderr, "invalid arguments\n");
+		return 1;
+	}
+	if(!verbose) {
+#if QT_VERSION >= 0x050000
+		qInstallMessageHandler(discardDebugMessages);
+#else
+		qInstallMsgHandler(discardDebugMessages);
+#endif
+	}
+
+#ifndef COUNT_ALLOCATIONS
+	if(measure_memory || measure_paint) {
+		::fprintf(stderr, "heap use can be measured with glibc only\n");
+		return 1;
+	}
+#endif
+
+	QByteArray data;
+	if(file_name) {
+		QFile f(QString::fromLocal8Bit(file_name));
+		if(!f.open(QIODevice::ReadOnly)) {
+			::fprintf(stderr, "cannot open %s\n", file_name);
+			return 1;
+		}
+		data = f.readAll();
+		if(data.isEmpty()) {
+			::fprintf(stderr, "%s is empty\n", file_name);
+			return 1;
+		}
+	}
+	else if(!measure_memory && !measure_paint && !trace_file_name) {
+		data = generateLog();
+	}
+
+	int master_fd, slave_fd;
+	if(::openpty(&master_fd, &slave_fd, 0, 0, 0) != 0) {
+		::perror("openpty");
+		return 1;
+	}
+	// SIGWINCH sent on resize is ignored by default
+	core::term::SlavePtyProcess pty(master_fd, ::getpid());
+	if(measure_memory) {
+		QByteArray screen_data = generateScreen(terminal_size);
+		int cells = terminal_size.width() * terminal_size.height();
+		::printf("%dx%d screen\n", terminal_size.width(), terminal_size.height());
+		// history bookkeeping is allocated by constructor, it does not grow with screen size
+		startCounting();
+		core::term::ScreenBuffer *screen = new core::term::ScreenBuffer(&pty);
+		printHeapUse("screen buffer constructor", 0);
+		startCounting();
+		screen->setTerminalSize(terminal_size);
+		printHeapUse("empty screen", cells);
+		startCounting();
+		screen->processInput(screen_data.constData(), screen_data.size());
+		printHeapUse("text written to screen", cells);
+		delete screen;
+		::close(slave_fd);
+		return 0;
+	}
+	core::term::ScreenBuffer screen(&pty);
+	screen.setTerminalSize(terminal_size);
+	if(trace_file_name) {
+		int ret = replayTrace(&screen, trace_file_name);
+		::close(slave_fd);
+		return ret;
+	}
+	if(measure_paint) {
+		QByteArray screen_data = generateScreen(terminal_size);
+		screen.processInput(screen_data.constData(), screen_data.size());
+		// TerminalWidget reserves the same
+		QString text_buffer;
+		text_buffer.reserve(512);
+		// the first frame may size buffers
+		paintFrame(&screen, &text_buffer);
+		startCounting();
+		for(int frame=0; frame<PaintFrames; frame++)
+			paintFrame(&screen, &text_buffer);
+		s_counting = false;
+		::printf("%d frames of %dx%d screen: %lld allocations, %.1f per frame\n",
+				 PaintFrames, terminal_size.width(), terminal_size.height(), s_allocations,
+				 static_cast<double>(s_allocations) / PaintFrames);
+		::close(slave_fd);
+		return 0;
+	}
+
+	qint64 fed = 0;
+	// time budgeted slice ends after the chunk which spent the budget,
+	// so key presses wait at most budget plus the longest chunk when parser runs on GUI thread
+	qint64 max_chunk_nsecs = 0;
+	QElapsedTimer tm;
+	tm.start();
+	while(fed < feed_size) {
+		for(int pos=0; pos<data.size() && fed<feed_size; pos += chunk_size) {
+			int n = qMin(chunk_size, data.size() - pos);
+			qint64 chunk_start = tm.nsecsElapsed();
+			screen.processInput(data.constData() + pos, n);
+			max_chunk_nsecs = qMax(max_chunk_nsecs, tm.nsecsElapsed() - chunk_start);
+			fed += n;
+		}
+	}
+	qint64 nsecs = qMax(tm.nsecsElapsed(), Q_INT64_C(1));
+	::close(slave_fd);
+
+	double mb = fed / (1024. * 1024.);
+	::printf("%s: %.1f MB in %d byte chunks, %dx%d terminal\n",
+			 file_name? file_name: "generated log", mb, chunk_size, terminal_size.width(), terminal_size.height());
+	::printf("%.3f s, %.2f MB/s, longest chunk %.3f ms\n", nsecs / 1e9, mb * 1e9 / nsecs, max_chunk_nsecs / 1e6);
+	return 0;
+}
+
+#include "parse-benchmark.moc"
@@ -0,0 +1,28 @@
+# Parser throughput benchmark, feeds a log through ScreenBuffer without GUI.
+# Links core sources of bbterm.
+
+QT       += core gui
+
+greaterThan(QT_MAJOR_VERSION, 4) {
+	QT += widgets
+}
+else {
+	DEFINES += Q_DECL_OVERRIDE=
+}
+
+TEMPLATE = app
+TARGET = parse-benchmark
+CONFIG += console
+CONFIG -= app_bundle
+
+!qnx {
+LIBS += \
+  -lutil \
+}
+
+INCLUDEPATH += ../../src
+
+include(../../src/core/core.pri)
+
+SOURCES += \
+	parse-benchmark.cpp
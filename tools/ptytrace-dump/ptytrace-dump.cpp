@@ -0,0 +1,142 @@
+// Print records of bbterm PTY trace file.
+//
+// usage: ptytrace-dump [-x] [-s] FILE
+//   -x  payload as hex dump instead of escaped text
+//   -s  summary only: record count, bytes and duration per direction
+
+#include "ptytraceformat.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+namespace {
+
+struct Stats
+{
+	Stats() : count(0), bytes(0) {}
+	uint64_t count;
+	uint64_t bytes;
+};
+
+void printEscaped(const unsigned char *data, uint32_t length)
+{
+	for(uint32_t i=0; i<length; i++) {
+		unsigned char c = data[i];
+		if(c == '\\')
+			fputs("\\\\", stdout);
+		else if(c == '\n')
+			fputs("\\n", stdout);
+		else if(c == '\r')
+			fputs("\\r", stdout);
+		else if(c == '\t')
+			fputs("\\t", stdout);
+		else if(c == 0x1b)
+			fputs("\\e", stdout);
+		else if(c < 0x20 || c == 0x7f)
+			printf("\\x%02x", c);
+		else
+			putchar(c);
+	}
+}
+
+void printHex(const unsigned char *data, uint32_t length)
+{
+	for(uint32_t i=0; i<length; i += 16) {
+		printf("\n    %06x ", i);
+		for(uint32_t j=i; j<i+16; j++) {
+			if(j < length)
+				printf(" %02x", data[j]);
+			else
+				fputs("   ", stdout);
+		}
+		fputs("  ", stdout);
+		for(uint32_t j=i; j<i+16 && j<length; j++)
+			putchar((data[j] >= 0x20 && data[j] < 0x7f)? data[j]: '.');
+	}
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+	bool hex = false;
+	bool summary = false;
+	const char *file_name = 0;
+	for(int i=1; i<argc; i++) {
+		if(!strcmp(argv[i], "-x"))
+			hex = true;
+		else if(!strcmp(argv[i], "-s"))
+			summary = true;
+		else
+			file_name = argv[i];
+	}
+	if(!file_name) {
+		fprintf(stderr, "usage: %s [-x] [-s] FILE\n", argv[0]);
+		return 1;
+	}
+	FILE *f = fopen(file_name, "rb");
+	if(!f) {
+		perror(file_name);
+		return 1;
+	}
+	PtyTraceHeader header;
+	if(fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, PTY_TRACE_MAGIC, sizeof(header.magic))) {
+		fprintf(stderr, "%s: not a PTY trace file\n", file_name);
+		return 1;
+	}
+	std::vector<unsigned char> ring(header.capacity);
+	fseek(f, header.headerSize, SEEK_SET);
+	if(header.capacity > 0 && fread(&ring[0], header.capacity, 1, f) != 1) {
+		fprintf(stderr, "%s: file is truncated\n", file_name);
+		return 1;
+	}
+	fclose(f);
+
+	Stats stats[3];
+	uint64_t first_nsecs = 0;
+	uint64_t last_nsecs = 0;
+	// wrapped ring starts with the oldest record and goes around to the write position
+	uint64_t pos = header.wrapped? header.oldestPos: 0;
+	bool is_second_lap = !header.wrapped || pos < header.writePos;
+	while(true) {
+		if(is_second_lap && pos >= header.writePos)
+			break;
+		if(pos + sizeof(PtyTraceRecord) > header.capacity) {
+			pos = 0;
+			is_second_lap = true;
+			continue;
+		}
+		const PtyTraceRecord *rec = reinterpret_cast<const PtyTraceRecord*>(&ring[pos]);
+		uint64_t size = ptyTraceRecordSize(rec->length);
+		if(pos + size > header.capacity) {
+			fprintf(stderr, "corrupted record at offset %llu\n", (unsigned long long)pos);
+			return 1;
+		}
+		if(rec->type != PtyTracePadding) {
+			if(!first_nsecs)
+				first_nsecs = rec->nsecs;
+			last_nsecs = rec->nsecs;
+			if(rec->type < 3) {
+				stats[rec->type].count++;
+				stats[rec->type].bytes += rec->length;
+			}
+			if(!summary) {
+				const unsigned char *payload = &ring[pos + sizeof(PtyTraceRecord)];
+				printf("%12.6f %s %6u ", (rec->nsecs - first_nsecs) / 1e9, (rec->type == PtyTraceRead)? "R": "W", rec->length);
+				if(hex)
+					printHex(payload, rec->length);
+				else
+					printEscaped(payload, rec->length);
+				putchar('\n');
+			}
+		}
+		pos += size;
+	}
+	double secs = (last_nsecs - first_nsecs) / 1e9;
+	printf("read:  %llu records, %llu bytes\n", (unsigned long long)stats[PtyTraceRead].count, (unsigned long long)stats[PtyTraceRead].bytes);
+	printf("write: %llu records, %llu bytes\n", (unsigned long long)stats[PtyTraceWrite].count, (unsigned long long)stats[PtyTraceWrite].bytes);
+	printf("time span: %.6f s%s\n", secs, header.wrapped? " (ring wrapped, older records were overwritten)": "");
+	return 0;
+}
@@ -0,0 +1,15 @@
+# Decoder of PTY trace files written by bbterm (BBTERM_TRACE, --trace or SIGUSR1).
+# Plain C++, it runs on the host where the trace file is copied.
+
+TEMPLATE = app
+TARGET = ptytrace-dump
+CONFIG += console
+CONFIG -= qt app_bundle
+
+INCLUDEPATH += ../../src/core/term
+
+SOURCES += \
+	ptytrace-dump.cpp
+
+HEADERS += \
+	../../src/core/term/ptytraceformat.h
@@ -0,0 +1,181 @@
+// Measure how long terminal takes to answer queries sent by editors and shells at startup.
+// Run it inside the terminal under test.
+//
+// usage: query-latency [-q QUERY] [-n COUNT] [-t TIMEOUT_MS] [-v]
+//   -q  da1, da2, dsr, cpr, version or startup (default),
+//       startup sends XTVERSION, DA2 and CPR followed by DA1 like neovim does
+//       and waits for DA1 answer, every terminal answers DA1 last
+//   -n  number of probes, default 20
+//   -t  probe without answer in this time counts as timeout, default 1000 ms
+//   -v  print every answer
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <string>
+
+namespace {
+
+struct Query
+{
+	const char *name;
+	const char *request;
+	// answer is complete when prefix is followed by final char
+	const char *replyPrefix;
+	char replyFinal;
+};
+
+const Query queries[] = {
+	{"da1", "\033[c", "\033[?", 'c'},
+	{"da2", "\033[>c", "\033[>", 'c'},
+	{"dsr", "\033[5n", "\033[", 'n'},
+	{"cpr", "\033[6n", "\033[", 'R'},
+	{"version", "\033[>q", "\033P>|", '\\'},
+	{"startup", "\033[>q\033[>c\033[6n\033[c", "\033[?", 'c'},
+};
+
+double nowMs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+bool isComplete(const std::string &reply, const Query &q)
+{
+	size_t pos = reply.find(q.replyPrefix);
+	if(pos == std::string::npos)
+		return false;
+	return reply.find(q.replyFinal, pos + strlen(q.replyPrefix)) != std::string::npos;
+}
+
+void printEscaped(const std::string &s)
+{
+	for(size_t i=0; i<s.size(); i++) {
+		unsigned char c = s[i];
+		if(c == 0x1b)
+			fputs("\\e", stdout);
+		else if(c < 0x20 || c == 0x7f)
+			printf("\\x%02x", c);
+		else
+			putchar(c);
+	}
+}
+
+// read everything terminal sends until timeout_ms of silence, answers of timed out probes must not spoil next probe
+void drain(int fd, int timeout_ms)
+{
+	char buff[256];
+	struct pollfd pfd = {fd, POLLIN, 0};
+	while(::poll(&pfd, 1, timeout_ms) > 0) {
+		if(::read(fd, buff, sizeof(buff)) <= 0)
+			break;
+	}
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+	const Query *query = &queries[5];
+	int count = 20;
+	int timeout_ms = 1000;
+	bool verbose = false;
+	for(int i=1; i<argc; i++) {
+		if(!strcmp(argv[i], "-q") && i + 1 < argc) {
+			const char *name = argv[++i];
+			query = 0;
+			for(size_t j=0; j<sizeof(queries) / sizeof(queries[0]); j++) {
+				if(!strcmp(queries[j].name, name))
+					query = &queries[j];
+			}
+			if(!query) {
+				fprintf(stderr, "unknown query: %s\n", name);
+				return 1;
+			}
+		}
+		else if(!strcmp(argv[i], "-n") && i + 1 < argc) {
+			count = atoi(argv[++i]);
+		}
+		else if(!strcmp(argv[i], "-t") && i + 1 < argc) {
+			timeout_ms = atoi(argv[++i]);
+		}
+		else if(!strcmp(argv[i], "-v")) {
+			verbose = true;
+		}
+		else {
+			fprintf(stderr, "usage: %s [-q da1|da2|dsr|cpr|version|startup] [-n COUNT] [-t TIMEOUT_MS] [-v]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	int fd = ::open("/dev/tty", O_RDWR | O_NOCTTY);
+	if(fd < 0) {
+		fprintf(stderr, "cannot open /dev/tty: %s\n", strerror(errno));
+		return 1;
+	}
+	struct termios saved_mode;
+	if(::tcgetattr(fd, &saved_mode) < 0) {
+		fprintf(stderr, "not a terminal: %s\n", strerror(errno));
+		return 1;
+	}
+	// answers must not be echoed nor wait for new line
+	struct termios raw_mode = saved_mode;
+	raw_mode.c_lflag &= ~(ICANON | ECHO);
+	raw_mode.c_cc[VMIN] = 1;
+	raw_mode.c_cc[VTIME] = 0;
+	::tcsetattr(fd, TCSANOW, &raw_mode);
+
+	double min_ms = 0, max_ms = 0, sum_ms = 0;
+	int answered = 0;
+	for(int i=0; i<count; i++) {
+		std::string reply;
+		double start = nowMs();
+		if(::write(fd, query->request, strlen(query->request)) < 0)
+			break;
+		bool complete = false;
+		while(!complete) {
+			int left_ms = timeout_ms - static_cast<int>(nowMs() - start);
+			struct pollfd pfd = {fd, POLLIN, 0};
+			if(left_ms <= 0 || ::poll(&pfd, 1, left_ms) <= 0)
+				break;
+			char buff[256];
+			ssize_t n = ::read(fd, buff, sizeof(buff));
+			if(n <= 0)
+				break;
+			reply.append(buff, n);
+			complete = isComplete(reply, *query);
+		}
+		double elapsed = nowMs() - start;
+		if(!complete) {
+			drain(fd, 100);
+			if(verbose)
+				printf("%3d  timeout\r\n", i);
+			continue;
+		}
+		if(verbose) {
+			printf("%3d  %8.3f ms  ", i, elapsed);
+			printEscaped(reply);
+			fputs("\r\n", stdout);
+		}
+		if(answered == 0 || elapsed < min_ms)
+			min_ms = elapsed;
+		if(elapsed > max_ms)
+			max_ms = elapsed;
+		sum_ms += elapsed;
+		answered++;
+	}
+	::tcsetattr(fd, TCSANOW, &saved_mode);
+	::close(fd);
+
+	printf("%s: %d probes, %d answered, %d timed out after %d ms\n", query->name, count, answered, count - answered, timeout_ms);
+	if(answered > 0)
+		printf("latency min %.3f ms, avg %.3f ms, max %.3f ms\n", min_ms, sum_ms / answered, max_ms);
+	return (answered == count)? 0: 2;
+}
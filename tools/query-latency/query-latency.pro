@@ -0,0 +1,10 @@
+# Startup latency benchmark of terminal query answers (DA1, DA2, DSR, CPR, XTVERSION).
+# Plain C++, it runs inside the terminal under test.
+
+TEMPLATE = app
+TARGET = query-latency
+CONFIG += console
+CONFIG -= qt app_bundle
+
+SOURCES += \
+	query-latency.cpp